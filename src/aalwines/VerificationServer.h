@@ -0,0 +1,215 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   VerificationServer.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_VERIFICATIONSERVER_H
+#define AALWINES_VERIFICATIONSERVER_H
+
+#include <aalwines/Verifier.h>
+#include <aalwines/query/QueryBuilder.h>
+#include <aalwines/query/parsererrors.h>
+#include <aalwines/model/NetworkWeight.h>
+#include <aalwines/utils/work_stealing_pool.h>
+
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <istream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace aalwines {
+
+    /**
+     * Answers queries over a network that is parsed (and pre-processed) only once.
+     * Requests and responses are newline delimited JSON objects:
+     *   request:  {"id": <any>, "query": "<query>", "weight": <weight function, optional>}
+     *   response: {"id": <any>, "answer": {...}} or {"id": <any>, "error": "<message>"}
+     * The answer has the same format as the answer for a single query in the normal output.
+     * Requests are verified concurrently (see --threads), so responses are written as each query finishes, not in request order.
+     */
+    class VerificationServer {
+        using weight_function = NetworkWeight::weight_function;
+    public:
+        VerificationServer(Builder& builder, Verifier& verifier, std::optional<weight_function> default_weight_fn, bool print_timing, std::string default_weight_key = "")
+        : _builder(builder), _verifier(verifier), _default_weight_fn(std::move(default_weight_fn)), _default_weight_key(std::move(default_weight_key)), _print_timing(print_timing),
+          _pool(utils::work_stealing_pool::resolve_threads(verifier.threads())) {
+            _builder.label_dictionary(); // Build the label dictionary and rule templates up front instead of during the first request.
+            _builder.rule_templates();
+            _builder.compiled_network();
+        }
+
+        // Answer requests from in until end of input, and wait for the answers to these requests to be written to out.
+        // The pool threads write the answers while this thread keeps reading, so in and out must not share a stream buffer.
+        // The pool is shared between calls, so completion is tracked per call instead of waiting for the whole pool.
+        void serve(std::istream& in, std::ostream& out) {
+            std::mutex out_mutex;
+            std::condition_variable answered;
+            size_t pending = 0; // Requests read by this call, but not yet answered. Guarded by out_mutex.
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+                {
+                    std::lock_guard<std::mutex> lock(out_mutex);
+                    ++pending;
+                }
+                _pool.submit([this, &out, &out_mutex, &answered, &pending, line = std::move(line)](){
+                    auto response = handle(line);
+                    std::lock_guard<std::mutex> lock(out_mutex);
+                    out << response.dump() << std::endl;
+                    --pending;
+                    answered.notify_all(); // Under the lock, since serve() may return as soon as pending is 0.
+                });
+            }
+            std::unique_lock<std::mutex> lock(out_mutex);
+            answered.wait(lock, [&pending](){ return pending == 0; });
+        }
+
+        // Accept connections on a Unix domain socket at path. Each connection is served as in serve(in, out).
+        void serve_unix_socket(const std::string& path) {
+            using boost::asio::local::stream_protocol;
+            boost::asio::io_context io_context;
+            std::remove(path.c_str()); // Remove stale socket file from earlier runs.
+            stream_protocol::acceptor acceptor(io_context, stream_protocol::endpoint(path));
+            struct connection_t {
+                std::thread thread;
+                std::atomic<bool> finished = false;
+            };
+            std::list<connection_t> connections; // A list, since the connection threads refer to their element.
+            auto join_finished = [&connections](){
+                for (auto it = connections.begin(); it != connections.end();) {
+                    if (it->finished) {
+                        it->thread.join();
+                        it = connections.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            };
+            while (true) {
+                auto in = std::make_unique<stream_protocol::iostream>();
+                boost::system::error_code ec;
+                acceptor.accept(in->socket(), ec);
+                if (ec) {
+                    std::cerr << "Error accepting connection on " << path << ": " << ec.message() << std::endl;
+                    break;
+                }
+                join_finished();
+                // Answers are written by the pool threads while the connection thread reads, so write them through a second stream on a duplicate of the socket.
+                auto out = std::make_unique<stream_protocol::iostream>();
+                out->socket().assign(stream_protocol(), ::dup(in->socket().native_handle()), ec);
+                if (ec) {
+                    std::cerr << "Error setting up connection on " << path << ": " << ec.message() << std::endl;
+                    continue;
+                }
+                auto& connection = connections.emplace_back();
+                connection.thread = std::thread([this, &connection, in = std::move(in), out = std::move(out)](){
+                    serve(*in, *out);
+                    connection.finished = true;
+                });
+            }
+            for (auto& connection : connections) {
+                connection.thread.join();
+            }
+        }
+
+    private:
+        json handle(const std::string& line) {
+            json response = json::object();
+            try {
+                auto request = json::parse(line);
+                if (!request.is_object() || !request.contains("query") || !request["query"].is_string()) {
+                    throw base_error("request must be a JSON object with a \"query\" string");
+                }
+                if (request.contains("id")) {
+                    response["id"] = request["id"];
+                }
+                auto query_string = request["query"].get<std::string>();
+                auto query = parse_query(query_string);
+
+                json answer;
+                if (request.contains("weight") && !request["weight"].is_null()) {
+                    auto weight_key = request["weight"].dump();
+                    std::stringstream wstream(weight_key);
+                    auto weight_fn = NetworkWeight().parse(wstream);
+                    answer = _verifier.run_query(_builder, query, query_string, weight_key, _print_timing, weight_fn);
+                } else if (_default_weight_fn) {
+                    answer = _verifier.run_query(_builder, query, query_string, _default_weight_key, _print_timing, _default_weight_fn.value());
+                } else {
+                    answer = _verifier.run_query(_builder, query, query_string, "", _print_timing);
+                }
+                response["answer"] = std::move(answer);
+            } catch (const base_parser_error& e) {
+                std::stringstream ss;
+                ss << e;
+                response["error"] = ss.str();
+            } catch (const std::exception& e) {
+                response["error"] = e.what();
+            }
+            return response;
+        }
+
+        // The parser appends to Builder::_result, so parsing is serialized and the new query is moved out right away.
+        Query parse_query(const std::string& query_string) {
+            std::lock_guard<std::mutex> lock(_parse_mutex);
+            auto old_size = _builder._result.size();
+            std::istringstream qstream(query_string);
+            try {
+                _builder.do_parse(qstream);
+            } catch (...) {
+                reset_parser(old_size);
+                throw;
+            }
+            if (_builder._result.size() != old_size + 1) {
+                reset_parser(old_size);
+                throw base_error("request must contain exactly one query");
+            }
+            Query query = std::move(_builder._result.back());
+            _builder._result.pop_back();
+            return query;
+        }
+        void reset_parser(size_t result_size) {
+            _builder._result.resize(result_size);
+            _builder.path_mode();
+            _builder.clear_post();
+            _builder.clear_link();
+            _builder.invert(false);
+        }
+
+        Builder& _builder;
+        Verifier& _verifier;
+        std::optional<weight_function> _default_weight_fn;
+        std::string _default_weight_key; // Identifies _default_weight_fn in the result cache.
+        bool _print_timing;
+        std::mutex _parse_mutex;
+        utils::work_stealing_pool _pool;
+    };
+
+}
+
+#endif //AALWINES_VERIFICATIONSERVER_H
@@ -31,9 +31,23 @@
 #include <aalwines/utils/json_stream.h>
 #include <aalwines/utils/stopwatch.h>
 #include <aalwines/utils/outcome.h>
+#include <aalwines/utils/query_budget.h>
+#include <aalwines/utils/result_cache.h>
+#include <aalwines/model/builders/AalWiNesBuilder.h>
 #include <aalwines/query/QueryBuilder.h>
 #include <aalwines/model/NetworkPDAFactory.h>
 #include <aalwines/model/NetworkWeight.h>
+#include <aalwines/utils/work_stealing_pool.h>
+#include <aalwines/utils/task_race.h>
+
+#include <array>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
 #include <boost/program_options.hpp>
 namespace po = boost::program_options;
@@ -95,8 +109,19 @@ namespace aalwines {
 
         explicit Verifier(const std::string& caption = "Verification Options") : verification(caption) {
             verification.add_options()
-                    ("engine,e", po::value<size_t>(&_engine), "0=no verification,1=post*,2=pre*,3=dual*,4=post*CEGAR,5=post*CEGARwithSimpleRefinement,6=post*NoAbstraction,7=dual*CEGAR")
+                    ("engine,e", po::value<size_t>(&_engine), "0=no verification,1=post*,2=pre*,3=dual*,4=post*CEGAR,5=post*CEGARwithSimpleRefinement,6=post*NoAbstraction,7=dual*CEGAR,8=portfolio")
                     ("trace,t", po::value<pdaaal::Trace_Type>(&_trace_type)->default_value(pdaaal::Trace_Type::None), "Trace type. 0=no trace, 1=any trace, 2=shortest trace, 3=longest trace")
+                    ("threads", po::value<size_t>(&_threads)->default_value(1), "Number of queries to verify concurrently. 0=use all hardware threads")
+                    ("build-threads", po::value<size_t>(&_build_threads)->default_value(1), "Number of threads used to build the PDA of each query (--engine 1, 2 or 3), or the initial abstraction (--engine 4, 5 or 7). 0=use all hardware threads")
+                    ("query-timeout", po::value<double>(&_query_timeout)->default_value(0), "Wall-clock limit in seconds for each query. It is checked while the PDA is built and between the solver phases, but not inside the post*, pre* or dual* loop of pdaaal. 0=no limit")
+                    ("portfolio", po::value<std::string>(&_portfolio)->default_value("1,2,3,4"), "Comma separated list of engines (1-7) raced by the portfolio engine (--engine 8)")
+                    ("result-cache", po::value<std::string>(&_result_cache_dir), "Directory of an on-disk cache of answers, keyed by network, query, engine, trace type and weight function.")
+                    ("cegar-abstraction-cache", po::value<std::string>(&_abstraction_cache_dir), "Directory where the final abstraction of --engine 4, 5 or 7 is saved per network and query (path, failures and headers), and used to warm-start later CEGAR runs of the same query.")
+                    ("process-memory-limit", po::value<size_t>(&_process_memory_limit)->default_value(0), "Limit in MB on the resident memory of the whole process, checked like --query-timeout. The query that is running when the limit is exceeded gives MEMOUT, so only one query may run at a time (not with --threads other than 1 or --engine 8). Memory kept from earlier queries counts as well. 0=no limit")
+                    ("lazy-pda", po::bool_switch(&_lazy_pda), "Only generate the PDA rules that can be reached from the construction header, found by a worklist over the possible top-of-stack labels. Only for --engine 1, 2 or 3")
+                    ("prune-pda", po::bool_switch(&_prune_pda), "Before building the PDA, find the (interface, path NFA state) pairs that are reachable from the start of the path and can reach its end, and leave out all other states. Only for --engine 1, 2 or 3")
+                    ("slice-labels", po::bool_switch(&_slice_labels), "Before building the PDA, find the labels that can be on top of the stack at each routing table given the construction header, and leave out the entries for all other labels. Only for --engine 1, 2 or 3")
+                    ("sweep-failures", po::bool_switch(&_sweep_failures), "Verify each query for 0 up to its number of failures, extending the PDA from one bound to the next, and report the smallest bound where the answer changes. Only for --engine 1, 2 or 3")
                     ;
         }
 
@@ -104,40 +129,277 @@ namespace aalwines {
         auto add_options() { return verification.add_options(); }
 
         void check_settings() const {
-            if(_engine > 7) {
+            if(_engine > 8) {
                 std::cerr << "Unknown value for --engine : " << _engine << std::endl;
                 exit(-1);
             }
+            if(_process_memory_limit != 0 && (_threads != 1 || _engine == 8)) {
+                // The limit is on the whole process, so a concurrent query or engine could make the running one give MEMOUT.
+                std::cerr << "--process-memory-limit requires --threads 1, and cannot be used with --engine 8" << std::endl;
+                exit(-1);
+            }
+            if(_sweep_failures && (_engine < 1 || _engine > 3)) {
+                std::cerr << "--sweep-failures is only supported for --engine 1, 2 or 3" << std::endl;
+                exit(-1);
+            }
+            if(_lazy_pda && (_engine < 1 || _engine > 3)) {
+                std::cerr << "--lazy-pda is only supported for --engine 1, 2 or 3" << std::endl;
+                exit(-1);
+            }
+            if(_prune_pda && (_engine < 1 || _engine > 3)) {
+                std::cerr << "--prune-pda is only supported for --engine 1, 2 or 3" << std::endl;
+                exit(-1);
+            }
+            if(_slice_labels && (_engine < 1 || _engine > 3)) {
+                std::cerr << "--slice-labels is only supported for --engine 1, 2 or 3" << std::endl;
+                exit(-1);
+            }
+            if(_engine == 8) {
+                try {
+                    portfolio_engines();
+                } catch (const base_error& e) {
+                    std::cerr << e.what() << std::endl;
+                    exit(-1);
+                }
+            }
         }
         void set_trace_type(pdaaal::Trace_Type trace_type) { _trace_type = trace_type; }
         void set_engine(size_t engine) { _engine = engine; }
+        void set_threads(size_t threads) { _threads = threads; }
+        void set_build_threads(size_t threads) { _build_threads = threads; }
+        void set_query_timeout(double seconds) { _query_timeout = seconds; }
+        void set_process_memory_limit(size_t megabytes) { _process_memory_limit = megabytes; }
+        void set_portfolio(const std::string& engines) { _portfolio = engines; }
+        void set_sweep_failures(bool sweep) { _sweep_failures = sweep; }
+        void set_lazy_pda(bool lazy) { _lazy_pda = lazy; }
+        void set_prune_pda(bool prune) { _prune_pda = prune; }
+        void set_slice_labels(bool slice) { _slice_labels = slice; }
+        [[nodiscard]] size_t engine() const { return _engine; }
+        [[nodiscard]] size_t threads() const { return _threads; }
+        // Cancelled portfolio engines (--engine 8) can still be running after the answer was returned, and they use the Builder and Network.
+        // Call this before those are destroyed, unless the Verifier is destroyed first.
+        void wait_for_cancelled_engines() { _portfolio_race.wait(); }
+        void set_result_cache(const std::string& directory) { _result_cache_dir = directory; }
+        void set_cegar_abstraction_cache(const std::string& directory) { _abstraction_cache_dir = directory; }
+        // Identifies the weight function given to run() in the result cache key, e.g. the content of the weight file.
+        void set_weight_key(const std::string& weight_key) { _weight_key = weight_key; }
 
         template<typename W_FN = std::function<void(void)>>
         void run(Builder& builder, const std::vector<std::string>& query_strings, json_stream& json_output, bool print_timing = true, const W_FN& weight_fn = [](){}) {
             if (_engine == 0) return; // By default don't run verifier if not specified.
-            size_t query_no = 0;
             json_output.begin_object("answers");
-            for (auto& q : builder._result) {
-                std::stringstream qn;
-                qn << "Q" << query_no+1;
+            auto groups = share_constructions<W_FN>(builder);
+            auto threads = utils::work_stealing_pool::resolve_threads(_threads);
+            if (threads <= 1 || groups.size() <= 1) {
+                for (size_t query_no = 0; query_no < builder._result.size(); ++query_no) {
+                    auto res = run_query(builder, builder._result[query_no], query_strings[query_no], _weight_key, print_timing, weight_fn);
+                    json_output.entry_object(query_name(query_no), res);
+                }
+            } else {
+                run_parallel(threads, groups, builder, query_strings, json_output, print_timing, weight_fn);
+            }
+            _shared_constructions.clear();
+            json_output.end_object();
+        }
 
+        // Like run_once, but uses the result cache (if enabled) and adds the query string to the answer.
+        template<typename W_FN = std::function<void(void)>>
+        json run_query(Builder& builder, Query& q, const std::string& query_string, const std::string& weight_key, bool print_timing = true, const W_FN& weight_fn = [](){}) {
+            if (_result_cache_dir.empty()) {
                 auto res = run_once(builder, q, print_timing, weight_fn);
-                res["query"] = query_strings[query_no];
-                json_output.entry_object(qn.str(), res);
-
-                ++query_no;
+                res["query"] = query_string;
+                return res;
             }
-            json_output.end_object();
+            stopwatch lookup_time;
+            auto key = result_cache_key(builder._network, query_string, weight_key);
+            if (auto cached = result_cache().lookup(key)) {
+                auto res = std::move(cached).value();
+                remove_timing(res); // The timing of the run that stored the answer does not describe this run.
+                res["query"] = query_string;
+                res["cached"] = true;
+                lookup_time.stop();
+                if (print_timing) {
+                    res["full-time"] = lookup_time.duration();
+                }
+                return res;
+            }
+            json res = run_once(builder, q, print_timing, weight_fn);
+            res["query"] = query_string;
+            auto result = res["result"].get<utils::outcome_t>();
+            if (result != utils::outcome_t::TIMEOUT && result != utils::outcome_t::MEMOUT) { // Running out of budget depends on the machine, so don't remember it.
+                json entry = res;
+                remove_timing(entry);
+                result_cache().store(key, entry);
+            }
+            return res;
         }
 
         template<typename W_FN = std::function<void(void)>>
         json run_once(Builder& builder, Query& q, bool print_timing = true, const W_FN& weight_fn = [](){}){
+            if (_engine == 8) {
+                return run_portfolio(builder, q, print_timing, weight_fn);
+            }
+            utils::query_budget budget(_query_timeout, _process_memory_limit * 1024 * 1024);
+            if (_sweep_failures) {
+                return run_sweep(builder, q, budget, print_timing, weight_fn);
+            }
+            return run_engine(_engine, builder, q, budget, print_timing, weight_fn, shared_construction<W_FN>(q));
+        }
+
+    private:
+        static constexpr const char* engine_name(size_t engine) {
+            constexpr const char* engine_types[] {"", "Post*", "Pre*", "Dual*", "CEGAR_Post*", "CEGAR_Post*_SimpleRefinement", "CEGAR_NoAbstraction_Post*", "CEGAR_Dual", "Portfolio"};
+            return engine_types[engine];
+        }
+
+        std::vector<size_t> portfolio_engines() const {
+            std::vector<size_t> engines;
+            std::stringstream ss(_portfolio);
+            std::string token;
+            while (std::getline(ss, token, ',')) {
+                size_t engine = 0;
+                try {
+                    engine = std::stoul(token);
+                } catch (const std::logic_error&) {
+                    throw base_error("error: --portfolio must be a comma separated list of engines, but got: " + _portfolio);
+                }
+                if (engine < 1 || engine > 7) {
+                    throw base_error("error: --portfolio engines must be between 1 and 7, but got: " + token);
+                }
+                if (std::find(engines.begin(), engines.end(), engine) == engines.end()) {
+                    engines.push_back(engine);
+                }
+            }
+            if (engines.empty()) {
+                throw base_error("error: --portfolio must contain at least one engine.");
+            }
+            return engines;
+        }
+
+        // Race the portfolio engines on separate threads, each with its own copy of the query.
+        // The first conclusive answer (YES or NO) wins and is returned right away. The other engines are cancelled through their budget,
+        // but an engine inside the pdaaal solver only stops when the solver returns, so they are left to stop in the background (see _portfolio_race).
+        template<typename W_FN>
+        json run_portfolio(Builder& builder, const Query& q, bool print_timing, const W_FN& weight_fn) {
+            auto engines = portfolio_engines();
+
+            std::vector<utils::task_race::task_t> tasks;
+            for (auto engine : engines) {
+                tasks.emplace_back([this, &builder, query = q, engine, print_timing, weight_fn](const utils::query_budget& budget) mutable {
+                    return run_engine(engine, builder, query, budget, print_timing, weight_fn);
+                });
+            }
+            stopwatch full_time;
+            auto [winner, runs] = _portfolio_race.run(std::move(tasks), [](const json& output){
+                auto result = output["result"].get<utils::outcome_t>();
+                return result == utils::outcome_t::YES || result == utils::outcome_t::NO;
+            }, _query_timeout, _process_memory_limit * 1024 * 1024);
+            full_time.stop();
+
+            json output;
+            if (winner) {
+                output = std::move(runs[winner.value()].output.value());
+                output["winner"] = engine_name(engines[winner.value()]);
+            } else {
+                // No conclusive answer, so every engine finished. Report the first engine that ran out of budget, otherwise MAYBE.
+                // If every engine failed with an error, there is nothing to report, so pass on the first error.
+                output["result"] = utils::outcome_t::MAYBE;
+                output["mode"] = q.approximation();
+                if (std::all_of(runs.begin(), runs.end(), [](const auto& run){ return run.error != nullptr; })) {
+                    std::rethrow_exception(runs[0].error);
+                }
+                for (const auto& run : runs) {
+                    if (!run.output) continue;
+                    auto result = run.output.value()["result"].template get<utils::outcome_t>();
+                    if (result == utils::outcome_t::TIMEOUT || result == utils::outcome_t::MEMOUT) {
+                        output["result"] = result;
+                        break;
+                    }
+                }
+            }
+            output["engine"] = engine_name(8);
+            auto& portfolio = output["portfolio"] = json::object();
+            for (size_t i = 0; i < engines.size(); ++i) {
+                const auto& run = runs[i];
+                auto& entry = portfolio[engine_name(engines[i])] = json::object();
+                if (run.error) {
+                    try {
+                        std::rethrow_exception(run.error);
+                    } catch (const std::exception& e) {
+                        entry["error"] = e.what();
+                    } catch (...) {
+                        entry["error"] = "unknown error";
+                    }
+                } else if (run.output) {
+                    entry["result"] = run.output.value()["result"];
+                } else { // Cancelled, and not stopped yet.
+                    entry["result"] = nullptr;
+                }
+                entry["cancelled"] = run.cancelled;
+                if (print_timing && (run.output || run.error)) { // Only engines that finished before the winner have a time.
+                    entry["time"] = run.time;
+                }
+            }
+            if (print_timing) {
+                output["full-time"] = full_time.duration();
+            }
+            return output;
+        }
+
+        // Verify q for 0, 1, ..., q.number_of_failures() failures. The PDA construction for k failures is extended to k+1 failures
+        // instead of being rebuilt (unless it is pruned, see --prune-pda). The answer is the one for q.number_of_failures(), with the result of each bound added under "sweep".
+        template<typename W_FN>
+        json run_sweep(Builder& builder, Query& q, const utils::query_budget& budget, bool print_timing, const W_FN& weight_fn) {
+            auto max_failures = q.number_of_failures();
+            SharedNetworkPDAConstruction<W_FN> construction;
+            json output;
+            auto sweep = json::array();
+            std::optional<utils::outcome_t> first_result;
+            std::optional<size_t> changes_at;
+            bool incomplete = false;
+            stopwatch full_time;
+            for (size_t failures = 0; failures <= max_failures; ++failures) {
+                q.set_number_of_failures(failures);
+                output = run_engine(_engine, builder, q, budget, print_timing, weight_fn, &construction);
+                auto result = output["result"].template get<utils::outcome_t>();
+                json entry;
+                entry["failures"] = failures;
+                entry["result"] = result;
+                if (print_timing) {
+                    entry["time"] = output["full-time"];
+                }
+                sweep.push_back(std::move(entry));
+                if (result == utils::outcome_t::TIMEOUT || result == utils::outcome_t::MEMOUT) { // The budget is for the whole sweep.
+                    incomplete = true;
+                    break;
+                }
+                if (result != utils::outcome_t::YES && result != utils::outcome_t::NO) continue; // Only conclusive results are compared.
+                if (!first_result) {
+                    first_result = result;
+                } else if (!changes_at && result != first_result.value()) {
+                    changes_at = failures;
+                }
+            }
+            full_time.stop();
+            q.set_number_of_failures(max_failures);
+            output["sweep"] = std::move(sweep);
+            // A change found before the sweep ran out of budget is still reported. Without one, an incomplete sweep does not show that the result never changes.
+            output["result-changes-at"] = changes_at ? json(changes_at.value()) : json();
+            output["sweep-incomplete"] = incomplete;
+            if (print_timing) {
+                output["full-time"] = full_time.duration();
+            }
+            return output;
+        }
+
+        template<typename W_FN>
+        json run_engine(size_t engine, Builder& builder, Query& q, const utils::query_budget& budget, bool print_timing, const W_FN& weight_fn,
+                        SharedNetworkPDAConstruction<W_FN>* construction = nullptr) {
             using weight_type = pdaaal::weight<typename W_FN::result_type>;
             constexpr static bool is_weighted = pdaaal::is_weighted<weight_type>;
 
             json output; // Store output information in this JSON object.
-            static const char *engineTypes[] {"", "Post*", "Pre*", "Dual*", "CEGAR_Post*", "CEGAR_Post*_SimpleRefinement", "CEGAR_NoAbstraction_Post*", "CEGAR_Dual"};
-            output["engine"] = engineTypes[_engine];
+            output["engine"] = engine_name(engine);
 
             // DUAL mode means first do OVER-approximation, then if that is inconclusive, do UNDER-approximation
             std::vector<Query::mode_t> modes = std::vector<Query::mode_t>{q.approximation()};
@@ -146,97 +408,136 @@ namespace aalwines {
 
             json json_trace;
             std::vector<unsigned int> trace_weight;
+            bool has_trace_weight = engine < 4 || engine > 7; // The CEGAR engines only find weighted traces for --trace 2 (see below).
             stopwatch full_time(false);
+            std::optional<CegarAbstraction> initial_abstraction;
+            CegarAbstraction final_abstraction;
+            CegarAbstraction* final_abstraction_ptr = nullptr;
+            if (!_abstraction_cache_dir.empty() && (engine == 4 || engine == 5 || engine == 7)) {
+                initial_abstraction = load_abstraction(builder._network, q);
+                final_abstraction_ptr = &final_abstraction;
+            }
 
             utils::outcome_t result = utils::outcome_t::MAYBE;
-            if (_engine == 4 || _engine == 5 || _engine == 6 || _engine == 7) {
-                std::optional<json> res;
-                full_time.start();
-                switch (_engine) {
-                    case 4: // CEGAR_Post*
-                        output["abstraction"] = json::object();
-                        res = CegarVerifier::verify<false,false,pdaaal::refinement_option_t::best_refinement>(builder._network, q, builder.all_labels(), output["abstraction"]);
-                        break;
-                    case 5: // CEGAR_Post*_SimpleRefinement
-                        output["abstraction"] = json::object();
-                        res = CegarVerifier::verify<false,false,pdaaal::refinement_option_t::fast_refinement>(builder._network, q, builder.all_labels(), output["abstraction"]);
-                        break;
-                    case 6: // CEGAR_NoAbstraction_Post*
-                        output["no_abstraction"] = json::object();
-                        res = CegarVerifier::verify<true>(builder._network, q, builder.all_labels(), output["no_abstraction"]);
-                        break;
-                    case 7: // CEGAR_Dual
-                        output["abstraction"] = json::object();
-                        res = CegarVerifier::verify<false,false,pdaaal::refinement_option_t::best_refinement,true>(builder._network, q, builder.all_labels(), output["abstraction"]);
-                        break;
-                    default:
-                        throw std::logic_error("Impossible case in Verifier. This should not happen.");
-                }
-                full_time.stop();
-                if (res) {
-                    result = utils::outcome_t::YES;
-                    json_trace = res.value();
-                } else {
-                    result = utils::outcome_t::NO;
-                }
-            } else {
-                stopwatch compilation_time(false);
-                stopwatch reachability_time(false);
-                stopwatch trace_making_time(false);
-                full_time.start();
-                for (auto m : modes) {
-                    json_trace = json(); // Clear trace from previous mode.
-
-                    // Construct PDA
-                    compilation_time.start();
-                    q.set_approximation(m);
-                    q.compile_nfas();
-
-                    bool engine_outcome;
-                    switch (_trace_type) {
-                        case pdaaal::Trace_Type::None:
-                        case pdaaal::Trace_Type::Any:
-                            engine_outcome = run_once_impl<pdaaal::Trace_Type::Any>(builder, q, weight_fn, trace_weight, result, json_trace, compilation_time, reachability_time, trace_making_time);
+            try {
+                if (engine == 4 || engine == 5 || engine == 6 || engine == 7) {
+                    std::optional<json> res;
+                    full_time.start();
+                    switch (engine) {
+                        case 4: // CEGAR_Post*
+                            output["abstraction"] = json::object();
+                            res = CegarVerifier::verify<false,false,pdaaal::refinement_option_t::best_refinement>(builder.compiled_network(), q, builder.label_dictionary(), output["abstraction"], &budget, utils::work_stealing_pool::resolve_threads(_build_threads),
+                                                                                                                 initial_abstraction ? &initial_abstraction.value() : nullptr, final_abstraction_ptr);
                             break;
-                        case pdaaal::Trace_Type::Shortest:
-                            engine_outcome = run_once_impl<pdaaal::Trace_Type::Shortest>(builder, q, weight_fn, trace_weight, result, json_trace, compilation_time, reachability_time, trace_making_time);
+                        case 5: // CEGAR_Post*_SimpleRefinement
+                            output["abstraction"] = json::object();
+                            res = CegarVerifier::verify<false,false,pdaaal::refinement_option_t::fast_refinement>(builder.compiled_network(), q, builder.label_dictionary(), output["abstraction"], &budget, utils::work_stealing_pool::resolve_threads(_build_threads),
+                                                                                                                 initial_abstraction ? &initial_abstraction.value() : nullptr, final_abstraction_ptr);
                             break;
-                        case pdaaal::Trace_Type::Longest:
-                            engine_outcome = run_once_impl<pdaaal::Trace_Type::Longest>(builder, q, weight_fn, trace_weight, result, json_trace, compilation_time, reachability_time, trace_making_time);
+                        case 6: // CEGAR_NoAbstraction_Post*
+                            output["no_abstraction"] = json::object();
+                            res = CegarVerifier::verify<true>(builder.compiled_network(), q, builder.label_dictionary(), output["no_abstraction"], &budget, utils::work_stealing_pool::resolve_threads(_build_threads));
                             break;
-                        case pdaaal::Trace_Type::ShortestFixedPoint:
-                            engine_outcome = run_once_impl<pdaaal::Trace_Type::ShortestFixedPoint>(builder, q, weight_fn, trace_weight, result, json_trace, compilation_time, reachability_time, trace_making_time);
+                        case 7: // CEGAR_Dual
+                            output["abstraction"] = json::object();
+                            res = CegarVerifier::verify<false,false,pdaaal::refinement_option_t::best_refinement,true>(builder.compiled_network(), q, builder.label_dictionary(), output["abstraction"], &budget, utils::work_stealing_pool::resolve_threads(_build_threads),
+                                                                                                                      initial_abstraction ? &initial_abstraction.value() : nullptr, final_abstraction_ptr);
                             break;
+                        default:
+                            throw std::logic_error("Impossible case in Verifier. This should not happen.");
                     }
-
-                    // Determine result from the outcome of verification and the mode (over/under-approximation) used.
-                    if (q.number_of_failures() == 0) {
-                        result = engine_outcome ? utils::outcome_t::YES : utils::outcome_t::NO;
-                    }
-                    if (result == utils::outcome_t::MAYBE && m == Query::mode_t::OVER && !engine_outcome) {
+                    if (res) {
+                        result = utils::outcome_t::YES;
+                        json_trace = res.value();
+                        if constexpr (is_weighted) {
+                            if (_trace_type == pdaaal::Trace_Type::Shortest) {
+                                // The CEGAR loop stops at the first trace of the abstraction that can be concretized, which need not be a shortest one.
+                                // So once it has shown that a trace exists, the shortest trace is found by weighted post* on the concrete network.
+                                stopwatch compilation_time(false), reachability_time(false), trace_making_time(false);
+                                compilation_time.start();
+                                json shortest_trace;
+                                run_once_impl<pdaaal::Trace_Type::Shortest>(1, builder, q, weight_fn, static_cast<SharedNetworkPDAConstruction<W_FN>*>(nullptr), budget, trace_weight, result, shortest_trace, compilation_time, reachability_time, trace_making_time);
+                                if (!shortest_trace.is_null()) { // Otherwise only an over-approximated trace was found, so keep the trace from CEGAR.
+                                    json_trace = std::move(shortest_trace);
+                                    has_trace_weight = true;
+                                    output["trace-engine"] = engine_name(1);
+                                }
+                            }
+                        }
+                    } else {
                         result = utils::outcome_t::NO;
                     }
-                    if (result != utils::outcome_t::MAYBE) {
-                        output["mode"] = m;
-                        break;
+                    full_time.stop();
+                } else {
+                    stopwatch compilation_time(false);
+                    stopwatch reachability_time(false);
+                    stopwatch trace_making_time(false);
+                    full_time.start();
+                    for (auto m : modes) {
+                        budget.check();
+                        json_trace = json(); // Clear trace from previous mode.
+
+                        // Construct PDA
+                        compilation_time.start();
+                        q.set_approximation(m);
+                        q.compile_nfas();
+
+                        bool engine_outcome;
+                        switch (_trace_type) {
+                            case pdaaal::Trace_Type::None:
+                            case pdaaal::Trace_Type::Any:
+                                engine_outcome = run_once_impl<pdaaal::Trace_Type::Any>(engine, builder, q, weight_fn, construction, budget, trace_weight, result, json_trace, compilation_time, reachability_time, trace_making_time);
+                                break;
+                            case pdaaal::Trace_Type::Shortest:
+                                engine_outcome = run_once_impl<pdaaal::Trace_Type::Shortest>(engine, builder, q, weight_fn, construction, budget, trace_weight, result, json_trace, compilation_time, reachability_time, trace_making_time);
+                                break;
+                            case pdaaal::Trace_Type::Longest:
+                                engine_outcome = run_once_impl<pdaaal::Trace_Type::Longest>(engine, builder, q, weight_fn, construction, budget, trace_weight, result, json_trace, compilation_time, reachability_time, trace_making_time);
+                                break;
+                            case pdaaal::Trace_Type::ShortestFixedPoint:
+                                engine_outcome = run_once_impl<pdaaal::Trace_Type::ShortestFixedPoint>(engine, builder, q, weight_fn, construction, budget, trace_weight, result, json_trace, compilation_time, reachability_time, trace_making_time);
+                                break;
+                        }
+
+                        // Determine result from the outcome of verification and the mode (over/under-approximation) used.
+                        if (q.number_of_failures() == 0) {
+                            result = engine_outcome ? utils::outcome_t::YES : utils::outcome_t::NO;
+                        }
+                        if (result == utils::outcome_t::MAYBE && m == Query::mode_t::OVER && !engine_outcome) {
+                            result = utils::outcome_t::NO;
+                        }
+                        if (result != utils::outcome_t::MAYBE) {
+                            output["mode"] = m;
+                            break;
+                        }
+                    }
+                    full_time.stop();
+                    if (print_timing) {
+                        output["compilation-time"] = compilation_time.duration();
+                        output["reachability-time"] = reachability_time.duration();
+                        output["trace-making-time"] = trace_making_time.duration();
                     }
                 }
+            } catch (const utils::budget_exceeded& e) {
+                // The query ran out of time or memory. Report it and let the caller continue with the next query.
                 full_time.stop();
-                if (print_timing) {
-                    output["compilation-time"] = compilation_time.duration();
-                    output["reachability-time"] = reachability_time.duration();
-                    output["trace-making-time"] = trace_making_time.duration();
-                }
+                result = e.outcome();
+                json_trace = json();
+            }
+            if (!final_abstraction.empty()) { // Also the refinements of a query that ran out of budget are useful for the next run.
+                abstraction_cache().store(abstraction_cache_key(builder._network, q), final_abstraction);
             }
 
             output["result"] = result;
 
             if (_trace_type != pdaaal::Trace_Type::None && result == utils::outcome_t::YES) {
                 if constexpr (is_weighted) {
-                    if (trace_weight == pdaaal::max_weight<typename weight_type::type>::bottom()) {
-                        output["trace-weight"] = "infinite";
-                    } else {
-                        output["trace-weight"] = trace_weight;
+                    if (has_trace_weight) {
+                        if (trace_weight == pdaaal::max_weight<typename weight_type::type>::bottom()) {
+                            output["trace-weight"] = "infinite";
+                        } else {
+                            output["trace-weight"] = trace_weight;
+                        }
                     }
                 }
                 output["trace"] = json_trace;
@@ -248,9 +549,180 @@ namespace aalwines {
             return output;
         }
 
-    private:
+        utils::result_cache& result_cache() {
+            std::call_once(_result_cache_flag, [this](){ _result_cache = std::make_unique<utils::result_cache>(_result_cache_dir); });
+            return *_result_cache;
+        }
+
+        utils::result_cache& abstraction_cache() {
+            std::call_once(_abstraction_cache_flag, [this](){ _abstraction_cache = std::make_unique<utils::result_cache>(_abstraction_cache_dir); });
+            return *_abstraction_cache;
+        }
+        // The final abstraction is only saved for the same path NFA, number of failures and header NFAs, so runs of different queries
+        // neither refine each other's abstraction further nor overwrite it. Concurrent runs of the same query write whole entries
+        // (result_cache::store renames a temporary file), and the last one wins.
+        std::string abstraction_cache_key(const Network& network, Query& q) {
+            q.compile_nfas();
+            std::stringstream key;
+            key << "cegar-abstraction network:" << network_fingerprint(network)
+                << " failures:" << q.number_of_failures()
+                << " path:" << q.path_signature()
+                << " headers:" << q.header_signature();
+            return key.str();
+        }
+        std::optional<CegarAbstraction> load_abstraction(const Network& network, Query& q) {
+            auto entry = abstraction_cache().lookup(abstraction_cache_key(network, q));
+            if (!entry) return std::nullopt;
+            try {
+                return entry->get<CegarAbstraction>();
+            } catch (const json::exception&) {
+                return std::nullopt; // Unreadable entry. Start from the default abstraction, and overwrite it afterwards.
+            }
+        }
+
+        // Hash of the network in the AalWiNes MPLS Network format. Computed once per network.
+        std::string network_fingerprint(const Network& network) {
+            std::lock_guard<std::mutex> lock(_fingerprint_mutex);
+            auto it = _network_fingerprints.find(&network);
+            if (it == _network_fingerprints.end()) {
+                json j = network;
+                it = _network_fingerprints.emplace(&network, utils::to_hex(utils::fnv1a_64(j.dump()))).first;
+            }
+            return it->second;
+        }
+
+        std::string result_cache_key(const Network& network, const std::string& query_string, const std::string& weight_key) {
+            std::stringstream key;
+            key << "network:" << network_fingerprint(network)
+                << " query:" << utils::normalize_whitespace(query_string)
+                << " engine:" << _engine;
+            if (_engine == 8) {
+                key << " portfolio:" << _portfolio;
+            }
+            if (_sweep_failures) {
+                key << " sweep";
+            }
+            key << " trace:" << _trace_type
+                << " weight:" << utils::to_hex(utils::fnv1a_64(weight_key));
+            return key.str();
+        }
+
+        // Remove the timing and memory measurements (also the nested ones of a portfolio, sweep or CEGAR run) from an answer.
+        static void remove_timing(json& answer) {
+            static const std::array<const char*, 11> keys{"full-time", "compilation-time", "reachability-time", "trace-making-time", "time",
+                                                          "build_pda", "solver", "reconstruction", "find_refinement", "refine", "resident_memory"};
+            if (answer.is_object()) {
+                for (const auto* key : keys) {
+                    answer.erase(key);
+                }
+            }
+            if (answer.is_structured()) {
+                for (auto& value : answer) {
+                    remove_timing(value);
+                }
+            }
+        }
+
+        static std::string query_name(size_t query_no) {
+            std::stringstream qn;
+            qn << "Q" << query_no+1;
+            return qn.str();
+        }
+
+        // Group queries that have the same path NFA and number of failures, and let each group share one NetworkPDAConstruction.
+        // Only engines 1-3 use NetworkPDAFactory. Returns the groups (singletons for queries that are not shared) in order of their first query.
+        template<typename W_FN>
+        std::vector<std::vector<size_t>> share_constructions(Builder& builder) {
+            std::vector<std::vector<size_t>> groups;
+            _shared_constructions.clear();
+            if (_engine < 1 || _engine > 3 || _sweep_failures || _lazy_pda || _slice_labels) { // A sweep extends its own construction, and lazy and sliced ones depend on the header.
+                for (size_t query_no = 0; query_no < builder._result.size(); ++query_no) {
+                    groups.push_back({query_no});
+                }
+                return groups;
+            }
+            std::unordered_map<std::string, size_t> group_of;
+            for (size_t query_no = 0; query_no < builder._result.size(); ++query_no) {
+                auto& q = builder._result[query_no];
+                q.compile_nfas();
+                std::stringstream key;
+                key << q.number_of_failures() << ":" << q.path_signature();
+                auto [it, fresh] = group_of.emplace(key.str(), groups.size());
+                if (fresh) {
+                    groups.emplace_back();
+                }
+                groups[it->second].push_back(query_no);
+            }
+            for (const auto& group : groups) {
+                if (group.size() < 2) continue;
+                auto slot = std::make_shared<SharedNetworkPDAConstruction<W_FN>>();
+                for (auto query_no : group) {
+                    _shared_constructions.emplace(&builder._result[query_no], slot);
+                }
+            }
+            return groups;
+        }
+        template<typename W_FN>
+        SharedNetworkPDAConstruction<W_FN>* shared_construction(const Query& q) const {
+            auto it = _shared_constructions.find(&q);
+            return it == _shared_constructions.end() ? nullptr : static_cast<SharedNetworkPDAConstruction<W_FN>*>(it->second.get());
+        }
+
+        // Verify the queries concurrently, but write the answers to json_output in the order of the queries.
+        // The network, the label dictionary and the weight function are shared (read-only) between the workers.
+        // Queries in the same group are verified in order by the same worker, since they share a NetworkPDAConstruction.
+        template<typename W_FN>
+        void run_parallel(size_t threads, const std::vector<std::vector<size_t>>& groups, Builder& builder, const std::vector<std::string>& query_strings, json_stream& json_output, bool print_timing, const W_FN& weight_fn) {
+            auto n = builder._result.size();
+
+            std::mutex mutex;
+            std::condition_variable answer_ready;
+            std::vector<json> answers(n);
+            std::vector<std::exception_ptr> errors(n);
+            std::vector<bool> done(n, false);
+
+            utils::work_stealing_pool pool(std::min(threads, groups.size()));
+            for (const auto& group : groups) {
+                pool.submit([&, &group=group](){
+                    for (auto query_no : group) {
+                        json res;
+                        std::exception_ptr error;
+                        try {
+                            res = run_query(builder, builder._result[query_no], query_strings[query_no], _weight_key, print_timing, weight_fn);
+                        } catch (...) {
+                            error = std::current_exception();
+                        }
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            answers[query_no] = std::move(res);
+                            errors[query_no] = error;
+                            done[query_no] = true;
+                        }
+                        answer_ready.notify_all();
+                    }
+                });
+            }
+            for (size_t query_no = 0; query_no < n; ++query_no) {
+                json res;
+                std::exception_ptr error;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    answer_ready.wait(lock, [&](){ return done[query_no]; });
+                    error = errors[query_no];
+                    res = std::move(answers[query_no]);
+                }
+                if (error) {
+                    // The workers still need the mutex to finish their queries, so wait for them without holding it.
+                    pool.wait();
+                    _shared_constructions.clear();
+                    std::rethrow_exception(error);
+                }
+                json_output.entry_object(query_name(query_no), res);
+            }
+        }
+
         template<pdaaal::Trace_Type trace_type, typename W_FN>
-        bool run_once_impl(Builder& builder, Query& q, const W_FN& weight_fn,
+        bool run_once_impl(size_t engine, Builder& builder, Query& q, const W_FN& weight_fn, SharedNetworkPDAConstruction<W_FN>* construction, const utils::query_budget& budget,
                            std::vector<unsigned int>& trace_weight, utils::outcome_t& result, json& json_trace,
                            stopwatch& compilation_time, stopwatch& reachability_time, stopwatch& trace_making_time){
             using weight_type = pdaaal::weight<typename W_FN::result_type>;
@@ -262,9 +734,17 @@ namespace aalwines {
                     throw base_error("error: Longest trace option requires weight to be specified.");
                 } else {
                     auto factory = makeNetworkPDAFactory<pdaaal::TraceInfoType::Pair>(q, builder._network, builder.all_labels(), weight_fn);
+                    factory.set_budget(&budget);
+                    factory.share_construction(construction);
+                    factory.set_compiled_network(&builder.compiled_network());
+                    factory.set_lazy(_lazy_pda);
+                    factory.set_pruning(_prune_pda);
+                    factory.set_label_slicing(_slice_labels);
+                    factory.set_threads(utils::work_stealing_pool::resolve_threads(_build_threads));
                     auto problem_instance = factory.compile(q.construction(), q.destruction());
                     compilation_time.stop();
-                    if (_engine == 3) {
+                    budget.check(); // The solver itself cannot be interrupted, so check before starting it.
+                    if (engine == 3) {
                         reachability_time.start();
                         bool used_pre_star;
                         auto instance_copy = problem_instance->copy();
@@ -284,7 +764,7 @@ namespace aalwines {
                         trace_making_time.stop();
                     } else {
                         reachability_time.start();
-                        switch (_engine) {
+                        switch (engine) {
                             case 1:
                                 engine_outcome = pdaaal::Solver::post_star_fixed_point_accepts<trace_type>(*problem_instance);
                                 break;
@@ -313,14 +793,22 @@ namespace aalwines {
                 throw base_error("Shortest trace using fixed point computation not yet supported."); // We could, but it is not a possible option, so this should not happen.
             } else {
                 NetworkPDAFactory factory(q, builder._network, builder.all_labels(), weight_fn);
+                factory.set_budget(&budget);
+                factory.share_construction(construction);
+                factory.set_compiled_network(&builder.compiled_network());
+                factory.set_lazy(_lazy_pda);
+                factory.set_pruning(_prune_pda);
+                factory.set_label_slicing(_slice_labels);
+                factory.set_threads(utils::work_stealing_pool::resolve_threads(_build_threads));
                 auto problem_instance = factory.compile(q.construction(), q.destruction());
                 compilation_time.stop();
+                budget.check(); // The solver itself cannot be interrupted, so check before starting it.
                 if constexpr (trace_type == pdaaal::Trace_Type::Shortest) {
                     if constexpr(!is_weighted) {
                         throw base_error("error: Shortest trace option requires weight to be specified.");
                     } else {
                         reachability_time.start();
-                        switch (_engine) {
+                        switch (engine) {
                             case 1:
                                 engine_outcome = pdaaal::Solver::post_star_accepts<trace_type>(*problem_instance);
                                 break;
@@ -337,7 +825,7 @@ namespace aalwines {
                         trace_making_time.start();
                         if (engine_outcome) {
                             std::vector<typename decltype(factory)::trace_state_t> pda_trace;
-                            std::tie(pda_trace, trace_weight) = (_engine == 3) ? pdaaal::Solver::get_trace_dual_search<trace_type>(*problem_instance) : pdaaal::Solver::get_trace<trace_type>(*problem_instance);
+                            std::tie(pda_trace, trace_weight) = (engine == 3) ? pdaaal::Solver::get_trace_dual_search<trace_type>(*problem_instance) : pdaaal::Solver::get_trace<trace_type>(*problem_instance);
                             json_trace = factory.get_json_trace(pda_trace);
                             if (!json_trace.is_null()) result = utils::outcome_t::YES;
                         }
@@ -345,7 +833,7 @@ namespace aalwines {
                     }
                 } else {
                     reachability_time.start();
-                    switch (_engine) {
+                    switch (engine) {
                         case 1:
                             engine_outcome = pdaaal::Solver::post_star_accepts<pdaaal::Trace_Type::Any>(*problem_instance);
                             break;
@@ -361,7 +849,7 @@ namespace aalwines {
                     reachability_time.stop();
                     trace_making_time.start();
                     if (engine_outcome) {
-                        auto pda_trace = (_engine == 3) ? pdaaal::Solver::get_trace_dual_search(*problem_instance) : pdaaal::Solver::get_trace(*problem_instance);
+                        auto pda_trace = (engine == 3) ? pdaaal::Solver::get_trace_dual_search(*problem_instance) : pdaaal::Solver::get_trace(*problem_instance);
                         json_trace = factory.get_json_trace(pda_trace);
                         if (!json_trace.is_null()) result = utils::outcome_t::YES;
                     }
@@ -376,9 +864,32 @@ namespace aalwines {
 
         // Settings
         size_t _engine = 0;
+        size_t _threads = 1;
+        size_t _build_threads = 1;
+        double _query_timeout = 0;      // Seconds, 0 means no limit.
+        size_t _process_memory_limit = 0; // MB of resident memory of the whole process, 0 means no limit.
+        std::string _portfolio = "1,2,3,4";
+        bool _sweep_failures = false;
+        bool _lazy_pda = false;
+        bool _prune_pda = false;
+        bool _slice_labels = false;
+        std::string _result_cache_dir;
+        std::string _abstraction_cache_dir;
+        std::string _weight_key;
+
+        std::once_flag _result_cache_flag;
+        std::unique_ptr<utils::result_cache> _result_cache;
+        std::once_flag _abstraction_cache_flag;
+        std::unique_ptr<utils::result_cache> _abstraction_cache; // Entries are CegarAbstraction, keyed by network and query.
+        std::mutex _fingerprint_mutex;
+        std::unordered_map<const Network*, std::string> _network_fingerprints;
+        // Set up by run() for queries that share the network part of the PDA. Values are SharedNetworkPDAConstruction<W_FN>.
+        std::unordered_map<const Query*, std::shared_ptr<void>> _shared_constructions;
         // size_t _reduction = 0;
         // bool _print_trace = false;
         pdaaal::Trace_Type _trace_type = pdaaal::Trace_Type::None;
+        // Last, so the cancelled portfolio engines (which use the members above) are joined first when the Verifier is destroyed.
+        utils::task_race _portfolio_race;
     };
 
 }
@@ -0,0 +1,60 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   CegarAbstraction.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_CEGARABSTRACTION_H
+#define AALWINES_CEGARABSTRACTION_H
+
+#include <limits>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace aalwines {
+
+    /**
+     * The interface and label partitions of a CEGAR abstraction, given as abstract ids indexed by interface global id and label dictionary id.
+     * Saved at the end of a CEGAR run, and used to warm-start later runs of the same query on the same network.
+     */
+    struct CegarAbstraction {
+        static constexpr size_t none() noexcept { return std::numeric_limits<size_t>::max(); } // Not in the abstraction.
+
+        std::vector<size_t> _interfaces;
+        std::vector<size_t> _labels;
+
+        [[nodiscard]] bool empty() const { return _interfaces.empty() && _labels.empty(); }
+        // Whether this can be the abstraction of a network with this many interfaces and labels.
+        [[nodiscard]] bool fits(size_t interfaces, size_t labels) const {
+            return _interfaces.size() == interfaces && _labels.size() == labels;
+        }
+    };
+
+    inline void to_json(nlohmann::json& j, const CegarAbstraction& abstraction) {
+        j = nlohmann::json{{"interfaces", abstraction._interfaces}, {"labels", abstraction._labels}};
+    }
+    inline void from_json(const nlohmann::json& j, CegarAbstraction& abstraction) {
+        j.at("interfaces").get_to(abstraction._interfaces);
+        j.at("labels").get_to(abstraction._labels);
+    }
+
+}
+
+#endif //AALWINES_CEGARABSTRACTION_H
@@ -29,13 +29,19 @@
 
 #include <aalwines/model/Query.h>
 #include <aalwines/model/Network.h>
+#include <aalwines/model/CompiledNetwork.h>
 #include <aalwines/query/QueryBuilder.h>
 #include <pdaaal/cegar/CegarPdaFactory.h>
 #include <aalwines/model/NetworkTranslation.h>
 #include <aalwines/utils/pointer_back_inserter.h>
 #include <aalwines/utils/ranges.h>
 #include <aalwines/model/EdgeStatus.h>
+#include <aalwines/model/CegarStatistics.h>
+#include <aalwines/model/CegarAbstraction.h>
+#include <aalwines/model/LabelDictionary.h>
+#include <aalwines/utils/query_budget.h>
 
+#include <algorithm>
 #include <utility>
 
 #include <nlohmann/json.hpp>
@@ -66,15 +72,16 @@ namespace aalwines {
     public:
         json& json_output;
 
+        // As for NetworkPDAFactory, the pdaaal base class keeps its own copy of all_labels (see there).
         template<typename label_abstraction_fn_t, typename interface_abstraction_fn_t>
-        CegarNetworkPdaFactory(json& json_output, const Network& network, const Query& query, std::unordered_set<label_t>&& all_labels,
+        CegarNetworkPdaFactory(json& json_output, const CompiledNetwork& compiled, const Query& query, const std::unordered_set<label_t>& all_labels,
                                label_abstraction_fn_t&& label_abstraction_fn,
                                interface_abstraction_fn_t&& interface_abstraction_fn)
         : parent_t(all_labels, std::forward<label_abstraction_fn_t>(label_abstraction_fn)), json_output(json_output),
               //_all_labels(std::move(all_labels)),
-              _translation(query, network, [](){}),
-              _query(query), //_failures(query.number_of_failures()),
-              _interface_abstraction(pdaaal::AbstractionMapping(std::forward<interface_abstraction_fn_t>(interface_abstraction_fn), network.all_interfaces().begin(), network.all_interfaces().end()))
+              _translation(query, compiled.network(), [](){}),
+              _compiled(compiled), _network(compiled.network()), _query(query), //_failures(query.number_of_failures()),
+              _interface_abstraction(pdaaal::AbstractionMapping(std::forward<interface_abstraction_fn_t>(interface_abstraction_fn), _network.all_interfaces().begin(), _network.all_interfaces().end()))
         {
             static_assert(std::is_convertible_v<label_abstraction_fn_t,
                     std::function<decltype(std::declval<label_abstraction_fn_t>()(std::declval<const label_t&>()))(const label_t&)>>);
@@ -82,16 +89,35 @@ namespace aalwines {
             json_output["cegar_iterations"] = 0;
         }
 
+        // Checked in each CEGAR iteration. May be nullptr for no limits.
+        void set_budget(const utils::query_budget* budget) { _budget = budget; }
+        // Records per-iteration statistics. May be nullptr.
+        void set_statistics(CegarStatistics* statistics) { _statistics = statistics; }
+        // Keeps output updated with the abstraction used in the latest iteration, which is the final abstraction when the run is over. May be nullptr.
+        // The whole abstraction is saved here, and each refinement only updates the interfaces and labels it moved.
+        void set_abstraction_output(CegarAbstraction* output, const LabelDictionary& labels) {
+            _abstraction_output = output;
+            _label_dictionary = &labels;
+            if (_abstraction_output != nullptr) {
+                save_abstraction(*_abstraction_output);
+            }
+        }
+
         void refine(std::variant<std::pair<pdaaal::Refinement<const Interface*>, pdaaal::Refinement<label_t>>, abstract_rule_t>&& refinement) {
+            utils::query_budget::check(_budget);
             if (refinement.index() == 0) { // Normal interface/label refinement
                 refine(std::get<0>(std::move(refinement)));
             } else {
                 assert(refinement.index() == 1); // Spurious abstract rule that needs to be removed.
+                enter_refine("spurious_rule");
                 add_spurious_rule(std::get<1>(std::move(refinement)));
                 // Here we don't need to remake stuff, since build_pda takes care of not adding the spurious rule.
             }
         }
         void refine(std::pair<pdaaal::Refinement<const Interface*>, pdaaal::Refinement<label_t>>&& refinement) {
+            bool refines_interface = refinement.first.partitions().size() > 1;
+            bool refines_label = refinement.second.partitions().size() > 1;
+            enter_refine(refines_interface ? (refines_label ? "interface_and_label" : "interface") : "label");
             auto new_interfaces_begin = _interface_abstraction.size();
             _interface_abstraction.refine(refinement.first);
             auto new_interfaces_end = _interface_abstraction.size();
@@ -106,10 +132,19 @@ namespace aalwines {
             }
             use_label_refinement(refinement.second.abstract_id, new_labels_end - new_labels_count, new_labels_end);
 
-            // TODO: Optimization: Find a way to refine and reuse tables...
-            make_tables();
+            update_tables(refinement.first.abstract_id, new_interfaces_begin, new_interfaces_end);
+            if (_abstraction_output != nullptr) {
+                for (auto a_inf = new_interfaces_begin; a_inf < new_interfaces_end; ++a_inf) {
+                    for (const auto& inf : _interface_abstraction.get_concrete_values_range(a_inf)) {
+                        _abstraction_output->_interfaces[inf->global_id()] = a_inf;
+                    }
+                }
+                save_labels(refinement.second);
+            }
         }
         void refine(pdaaal::HeaderRefinement<label_t>&& header_refinement) {
+            utils::query_budget::check(_budget);
+            enter_refine("header");
             /* --Not yet used...
             auto new_labels_end = this->number_of_labels();
             for (auto it = header_refinement.refinements().crbegin(); it < header_refinement.refinements().crend(); ++it) { // Header refinements were applied in order, so we go back in reverse.
@@ -123,12 +158,17 @@ namespace aalwines {
                 assert(new_labels_end > new_labels_count);
                 new_labels_end -= new_labels_count;
             }*/
-            // TODO: Optimization: Find a way to refine and reuse tables...
-            make_tables();
+            update_tables(0, 0, 0);
+            if (_abstraction_output != nullptr) {
+                for (const auto& refinement : header_refinement.refinements()) {
+                    save_labels(refinement);
+                }
+            }
         }
 
     protected:
         void build_pda() override {
+            if (_statistics != nullptr) _statistics->enter(CegarStatistics::phase_t::BUILD_PDA);
             // Since we don't reset states when refining (to keep indexes consistent) we don't a priori know which states are still valid.
             // For states with ops.empty() we use _edges to check validity, for !ops.empty() we store the reachable states here.
             // Keeping all states can increase the PDA size a bit, since the PDA datastructure assumes consecutive state ids, i.e. it will also create entries for the unused states.
@@ -137,6 +177,7 @@ namespace aalwines {
 
             size_t count_rules = 0;
             for (size_t from_state = 0; from_state < _abstract_states.size(); ++from_state) {
+                utils::query_budget::check(_budget);
                 auto [a_inf, nfa_state, ops] = _abstract_states.at(from_state);
                 if (ops.empty()) {
                     const auto& table = _abstract_tables[a_inf]; // TODO: Add begin(),end() to pdaaal::ptrie_set...
@@ -184,6 +225,10 @@ namespace aalwines {
             json_output["labels"] = this->number_of_labels();
             json_output["interfaces"] = _interface_abstraction.size();
             json_output["cegar_iterations"] = json_output["cegar_iterations"].get<int>() + 1;
+            if (_statistics != nullptr) {
+                _statistics->pda_size(count_rules, _abstract_states.size(), this->number_of_labels(), _interface_abstraction.size());
+                _statistics->enter(CegarStatistics::phase_t::SOLVER);
+            }
             //std::cout << "; rules: " << count_rules << "; labels: " << this->number_of_labels() << "; (interfaces: " << _interface_abstraction.size() << ")" << std::endl; // FIXME: Remove...
         }
         const std::vector<size_t>& initial() override {
@@ -194,6 +239,35 @@ namespace aalwines {
         }
 
     private:
+        void save_abstraction(CegarAbstraction& abstraction) const {
+            abstraction._interfaces.assign(_network.all_interfaces().size(), CegarAbstraction::none());
+            for (const auto& inf : _network.all_interfaces()) {
+                auto [found, a_inf] = _interface_abstraction.exists(inf);
+                if (found) abstraction._interfaces[inf->global_id()] = a_inf;
+            }
+            abstraction._labels.assign(_label_dictionary->size(), CegarAbstraction::none());
+            for (size_t id = 0; id < _label_dictionary->size(); ++id) {
+                auto [found, a_label] = this->abstract_label(_label_dictionary->label(id));
+                if (found) abstraction._labels[id] = a_label;
+            }
+        }
+        // The labels of a refinement are the ones that can have moved to another abstract label.
+        void save_labels(const pdaaal::Refinement<label_t>& refinement) {
+            for (const auto& partition : refinement.partitions()) {
+                for (const auto& label : partition) {
+                    auto id = _label_dictionary->id(label);
+                    if (!id) continue;
+                    auto [found, a_label] = this->abstract_label(label);
+                    _abstraction_output->_labels[id.value()] = found ? a_label : CegarAbstraction::none();
+                }
+            }
+        }
+        void enter_refine(const char* kind) {
+            if (_statistics == nullptr) return;
+            _statistics->enter(CegarStatistics::phase_t::REFINE);
+            _statistics->refinement(kind);
+        }
+
         template<bool initial=false>
         void add_state(const nfa_state_t* nfa_state, const Interface* inf, size_t a_inf) {
             auto [abstract_fresh, abstract_id] = _abstract_states.insert({a_inf, nfa_state, a_ops_t{}});
@@ -221,7 +295,7 @@ namespace aalwines {
                     }
                 }
             });
-            make_edges<true>(std::move(seen), std::move(waiting));
+            make_edges(std::move(seen), std::move(waiting));
             make_tables();
         }
 
@@ -232,10 +306,6 @@ namespace aalwines {
             // except that the ids of abstract states are kept stable.
             // This is useful for keeping _spurious_rules consistent.
 
-            std::unordered_set<std::pair<const Interface*, const nfa_state_t*>,
-                    absl::Hash<std::pair<const Interface*, const nfa_state_t*>>> seen;
-            std::vector<std::tuple<const Interface*, const nfa_state_t*,size_t>> waiting;
-
             // The refinement might make some old _initial states stop being initial.
             // Here we find nfa_states s such that (old_interface, s) was initial.
             std::vector<const nfa_state_t*> old_initial;
@@ -246,12 +316,9 @@ namespace aalwines {
                 assert(std::is_sorted(next.begin(), next.end()));
                 auto a_inf = _interface_abstraction.exists(inf).second;
                 bool is_new = new_interfaces_begin <= a_inf && a_inf < new_interfaces_end;
-                for (const auto& n : next) {
-                    if (seen.emplace(inf, n).second) {
-                        waiting.emplace_back(inf, n, a_inf);
-                        if (is_new) {
-                            add_state<true>(n, inf, a_inf); // We only add new states.
-                        }
+                if (is_new) {
+                    for (const auto& n : next) {
+                        add_state<true>(n, inf, a_inf); // We only add new states.
                     }
                 }
                 if (a_inf == old_interface) {
@@ -276,11 +343,66 @@ namespace aalwines {
                 _initial.erase(it);
             }
 
-            // Nothing fancy here, just clear and remake the edges.
-            _edges.clear();
-            make_edges(std::move(seen), std::move(waiting), [new_interfaces_begin, new_interfaces_end](size_t a_inf){
-                return new_interfaces_begin <= a_inf && a_inf < new_interfaces_end;
-            });
+            // The concrete pairs and edges found by make_edges do not depend on the abstraction, so only the abstract edges
+            // from or to old_interface or [new_interfaces_begin, new_interfaces_end) change. Before the refinement, all the
+            // concrete interfaces now in one of these abstract interfaces were in old_interface.
+            auto is_refined = [old_interface, new_interfaces_begin, new_interfaces_end](size_t a_inf) {
+                return a_inf == old_interface || (new_interfaces_begin <= a_inf && a_inf < new_interfaces_end);
+            };
+            std::vector<const Interface*> refined;
+            auto add_refined = [&refined, this](size_t a_inf) {
+                for (const auto& inf : _interface_abstraction.get_concrete_values_range(a_inf)) {
+                    refined.push_back(inf);
+                }
+            };
+            add_refined(old_interface);
+            for (auto a_inf = new_interfaces_begin; a_inf < new_interfaces_end; ++a_inf) {
+                add_refined(a_inf);
+            }
+            std::vector<size_t> changed;
+            for (const auto& inf : refined) {
+                const auto& edges = _edges_by_interface[inf->global_id()];
+                changed.insert(changed.end(), edges.begin(), edges.end());
+            }
+            std::sort(changed.begin(), changed.end());
+            changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+            auto previous = [&is_refined, old_interface, this](const Interface* inf) {
+                auto a_inf = abstract_interface(inf);
+                return is_refined(a_inf) ? old_interface : a_inf;
+            };
+            for (auto id : changed) {
+                const auto& edge = _concrete_edges[id];
+                _edges.erase(std::make_tuple(previous(edge._from), edge._state, previous(edge._to)));
+            }
+            for (auto id : changed) {
+                const auto& edge = _concrete_edges[id];
+                add_edge(abstract_interface(edge._from), edge._state, abstract_interface(edge._to), edge._to_state);
+            }
+
+            // Add the states of the moved interfaces, and update the abstract interfaces of their relevant tables.
+            std::vector<const RoutingTable*> tables;
+            for (const auto& inf : refined) {
+                const auto& reached = _reached[inf->global_id()];
+                if (reached.empty()) continue;
+                auto a_inf = abstract_interface(inf);
+                if (a_inf != old_interface) {
+                    for (const auto& nfa_state : reached) {
+                        add_state(nfa_state, inf, a_inf);
+                    }
+                }
+                tables.push_back(_compiled.table(_compiled.interface_table(inf->global_id())));
+            }
+            std::sort(tables.begin(), tables.end());
+            tables.erase(std::unique(tables.begin(), tables.end()), tables.end());
+            for (const auto& table : tables) {
+                auto& a_infs = _relevant_tables[table];
+                a_infs.clear();
+                for (const auto& inf : table->interfaces()) {
+                    if (!_reached[inf->global_id()].empty()) {
+                        a_infs.emplace(abstract_interface(inf));
+                    }
+                }
+            }
 
             // TODO: (Maybe) Refine spurious rules that match  old_interface -> [new_interfaces_begin, new_interfaces_end).
         }
@@ -318,36 +440,53 @@ namespace aalwines {
             }
         }
 
-        template<bool first_time = false>
+        [[nodiscard]] size_t abstract_interface(const Interface* inf) const {
+            return _interface_abstraction.exists(inf).second;
+        }
+
+        void add_edge(size_t a_inf, const nfa_state_t* nfa_state, size_t a_to_inf, const nfa_state_t* to_state) {
+            auto& to_states = _edges[std::make_tuple(a_inf, nfa_state, a_to_inf)];
+            if (std::find(to_states.begin(), to_states.end(), to_state) == to_states.end()) {
+                to_states.push_back(to_state);
+            }
+        }
+
+        // Walks the concrete (interface, NFA state) pairs reachable from the initial ones. This is only done once;
+        // refine_states re-abstracts the concrete pairs and edges stored here.
         void make_edges(std::unordered_set<std::pair<const Interface*, const nfa_state_t*>, absl::Hash<std::pair<const Interface*, const nfa_state_t*>>>&& seen,
-                        std::vector<std::tuple<const Interface*, const nfa_state_t*,size_t>>&& waiting,
-                        const std::function<bool(size_t)>& is_new = [](const auto&){return true;}) {
-            auto add = [&seen, &waiting, &is_new, this](const nfa_state_t* n, const Interface* inf, size_t a_inf) {
+                        std::vector<std::tuple<const Interface*, const nfa_state_t*,size_t>>&& waiting) {
+            auto add = [&seen, &waiting, this](const nfa_state_t* n, const Interface* inf, size_t a_inf) {
                 if (seen.emplace(inf, n).second) {
                     waiting.emplace_back(inf, n, a_inf);
-                    if constexpr (first_time) {
-                        add_state(n, inf, a_inf);
-                    } else {
-                        if (is_new(a_inf)) {
-                            add_state(n, inf, a_inf);
-                        }
-                    }
+                    add_state(n, inf, a_inf);
                 }
             };
+            _reached.assign(_network.all_interfaces().size(), {});
+            _edges_by_interface.assign(_network.all_interfaces().size(), {});
+            _concrete_edges.clear();
+            _edges.clear();
             _relevant_tables.clear();
             while (!waiting.empty()) {
                 auto [inf, nfa_state, a_inf] = waiting.back();
                 waiting.pop_back();
+                _reached[inf->global_id()].push_back(nfa_state);
 
-                _relevant_tables.try_emplace(inf->table()).first->second.emplace(a_inf);
+                auto table_id = _compiled.interface_table(inf->global_id());
+                _relevant_tables.try_emplace(_compiled.table(table_id)).first->second.emplace(a_inf);
 
-                for (const Interface* out_inf : inf->table()->out_interfaces()) {
-                    auto to_inf = out_inf->match();
+                for (auto out_id : _compiled.table_out_interfaces(table_id)) {
+                    auto to_inf = _compiled.interface(_compiled.interface_match(out_id));
                     auto a_to_inf = _interface_abstraction.exists(to_inf).second;
                     for (const auto& e : nfa_state->_edges) {
                         for (const auto& n : e.follow_epsilon()) {
-                            if (!e.contains(out_inf->global_id())) continue;
-                            _edges.emplace(std::make_tuple(a_inf,nfa_state,a_to_inf), n);
+                            if (!e.contains(out_id)) continue;
+                            auto id = _concrete_edges.size();
+                            _concrete_edges.push_back({inf, nfa_state, to_inf, n});
+                            _edges_by_interface[inf->global_id()].push_back(id);
+                            if (to_inf != inf) {
+                                _edges_by_interface[to_inf->global_id()].push_back(id);
+                            }
+                            add_edge(a_inf, nfa_state, a_to_inf, n);
                             add(n, to_inf, a_to_inf);
                         }
                     }
@@ -358,8 +497,76 @@ namespace aalwines {
         void make_tables() {
             _abstract_tables.clear();
             _abstract_tables = std::vector<table_t>(_interface_abstraction.size());
+            _tables_by_label.clear();
+            _tables_by_next_hop.clear();
             for (const auto& [table, a_infs] : _relevant_tables) {
                 process_table(table, std::vector<size_t>(a_infs.begin(), a_infs.end()));
+                index_table(table);
+            }
+            _tables_labels = this->number_of_labels();
+        }
+
+        // After a refinement, only remake the abstract tables that changed. The concrete (interface, NFA state) pairs reached
+        // by make_edges do not depend on the abstraction, so the relevant tables stay the same, and an abstract table only changes if:
+        //  - it is the refined abstract interface or one of the new ones split from it (old_interface -> [new_interfaces_begin, new_interfaces_end)), or
+        //  - it has a concrete table forwarding to an interface that was moved to a new abstract interface, or
+        //  - it has a concrete table with an entry whose pre label or op label was moved to a new abstract label.
+        void update_tables(size_t old_interface, size_t new_interfaces_begin, size_t new_interfaces_end) {
+            std::vector<bool> dirty(_interface_abstraction.size(), false);
+            auto mark_table = [&dirty, this](const RoutingTable* table) {
+                auto it = _relevant_tables.find(table);
+                if (it == _relevant_tables.end()) return;
+                for (auto a_inf : it->second) dirty[a_inf] = true;
+            };
+            if (new_interfaces_begin != new_interfaces_end) {
+                dirty[old_interface] = true;
+                std::fill(dirty.begin() + new_interfaces_begin, dirty.begin() + new_interfaces_end, true);
+                for (const auto& [next_hop, tables] : _tables_by_next_hop) {
+                    auto a_inf = _interface_abstraction.exists(next_hop).second;
+                    if (new_interfaces_begin <= a_inf && a_inf < new_interfaces_end) {
+                        for (const auto& table : tables) mark_table(table);
+                    }
+                }
+            }
+            if (_tables_labels != this->number_of_labels()) {
+                for (const auto& [label, tables] : _tables_by_label) {
+                    auto [found, a_label] = this->abstract_label(label);
+                    if (found && a_label >= _tables_labels) {
+                        for (const auto& table : tables) mark_table(table);
+                    }
+                }
+                _tables_labels = this->number_of_labels();
+            }
+
+            _abstract_tables.resize(_interface_abstraction.size());
+            for (size_t a_inf = 0; a_inf < dirty.size(); ++a_inf) {
+                if (dirty[a_inf]) _abstract_tables[a_inf] = table_t();
+            }
+            for (const auto& [table, a_infs] : _relevant_tables) {
+                std::vector<size_t> dirty_a_infs;
+                for (auto a_inf : a_infs) {
+                    if (dirty[a_inf]) dirty_a_infs.push_back(a_inf);
+                }
+                if (!dirty_a_infs.empty()) {
+                    process_table(table, std::move(dirty_a_infs));
+                }
+            }
+        }
+
+        // Remember which concrete labels and next hops the abstract rules of table depend on.
+        void index_table(const RoutingTable* table) {
+            auto add = [table](std::vector<const RoutingTable*>& tables) {
+                if (tables.empty() || tables.back() != table) tables.push_back(table);
+            };
+            for (const auto& entry : table->entries()) {
+                for (const auto& forward : entry._rules) {
+                    if (forward._priority > _query.number_of_failures()) continue;
+                    if (entry._top_label != Query::wildcard_label()) add(_tables_by_label[entry._top_label]);
+                    for (const auto& action : forward._ops) {
+                        if (action._op != RoutingTable::op_t::POP) add(_tables_by_label[action._op_label]);
+                    }
+                    add(_tables_by_next_hop[forward._via->match()]);
+                }
             }
         }
 
@@ -373,6 +580,8 @@ namespace aalwines {
     private:
         //std::unordered_set<label_t> _all_labels;
         Translation _translation; // TODO: Figure out how to use common parts from Translation.
+        const CompiledNetwork& _compiled;
+        const Network& _network;
         const Query& _query;
         pdaaal::RefinementMapping<const Interface*> _interface_abstraction; // This is what gets refined by CEGAR.
 
@@ -381,15 +590,34 @@ namespace aalwines {
 
         // Keeps track of which tables (interfaces) have been processed, and remembers for next time (when useful)...
         std::unordered_map<const RoutingTable*, std::unordered_set<size_t>> _relevant_tables;
+        // The relevant tables with rules that use a concrete label or next hop. Used by update_tables.
+        std::unordered_map<label_t, std::vector<const RoutingTable*>> _tables_by_label;
+        std::unordered_map<const Interface*, std::vector<const RoutingTable*>> _tables_by_next_hop;
+        size_t _tables_labels = 0; // The number of abstract labels when the abstract tables were last updated.
 
         // The idea is to only go through concrete tables once and only go through (concrete) path regex once.
         // Combine (product) abstracted versions of tables and path.
-        pdaaal::fut::set<std::tuple<std::tuple<size_t, const nfa_state_t*, size_t>, const nfa_state_t*>,
-                pdaaal::fut::type::hash, pdaaal::fut::type::vector> _edges; // Given (a(e),s,a(e')) Lists all s' such that (e,s) -> (e',s'), i.e. s --e'-> s' and e' \in out_infs[e]
+        using edge_key_t = std::tuple<size_t, const nfa_state_t*, size_t>;
+        std::unordered_map<edge_key_t, std::vector<const nfa_state_t*>, absl::Hash<edge_key_t>> _edges; // Given (a(e),s,a(e')) Lists all s' such that (e,s) -> (e',s'), i.e. s --e'-> s' and e' \in out_infs[e]
+        // The concrete edges (e,s) -> (e',s') found by make_edges, and for each interface (by global id) the ids of the
+        // concrete edges from or to it and the NFA states s such that (e,s) is reached. Used by refine_states.
+        struct concrete_edge_t {
+            const Interface* _from;
+            const nfa_state_t* _state;
+            const Interface* _to;
+            const nfa_state_t* _to_state;
+        };
+        std::vector<concrete_edge_t> _concrete_edges;
+        std::vector<std::vector<size_t>> _edges_by_interface;
+        std::vector<std::vector<const nfa_state_t*>> _reached;
 
         pdaaal::ptrie_set<abstract_rule_t> _spurious_rules;
         std::vector<size_t> _initial;
         std::vector<size_t> _accepting;
+        const utils::query_budget* _budget = nullptr;
+        CegarStatistics* _statistics = nullptr;
+        CegarAbstraction* _abstraction_output = nullptr;
+        const LabelDictionary* _label_dictionary = nullptr;
     };
 
     using cegar_configuration_t = std::tuple<pdaaal::Header<Query::label_t>,              // Current header (possibly set of headers represented using wildcards)
@@ -443,7 +671,9 @@ namespace aalwines {
         using header_refinement_t = typename parent_t::header_refinement_t;
 
         explicit CegarNetworkPdaReconstruction(const factory_t& factory, const product_t& instance, const pdaaal::NFA<label_t>& initial_headers, const pdaaal::NFA<label_t>& final_headers)
-        : parent_t(instance, initial_headers, final_headers), _factory(factory) {};
+        : parent_t(instance, initial_headers, final_headers), _factory(factory) {
+            if (_factory._statistics != nullptr) _factory._statistics->enter(CegarStatistics::phase_t::RECONSTRUCTION);
+        }
 
     protected:
 
@@ -464,6 +694,7 @@ namespace aalwines {
             });
         }
         refinement_t find_initial_refinement(const abstract_rule_t& abstract_rule) override {
+            CegarStatistics::scope statistics_scope(_factory._statistics, CegarStatistics::phase_t::FIND_REFINEMENT);
             std::vector<std::pair<state_t,label_t>> X;
             auto [a_inf, nfa_state, ops] = _factory._abstract_states.at(abstract_rule._from);
             auto labels = this->pre_labels(this->initial_header());
@@ -495,6 +726,7 @@ namespace aalwines {
             }
         }
         refinement_t find_refinement(const abstract_rule_t& abstract_rule, const std::vector<configuration_t>& configurations) override {
+            CegarStatistics::scope statistics_scope(_factory._statistics, CegarStatistics::phase_t::FIND_REFINEMENT);
             std::vector<std::pair<state_t,label_t>> X;
             assert(std::get<2>(_factory._abstract_states.at(abstract_rule._from)).empty());
             auto [a_inf, nfa_state, ops] = _factory._abstract_states.at(abstract_rule._from);
@@ -0,0 +1,134 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   CegarStatistics.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_CEGARSTATISTICS_H
+#define AALWINES_CEGARSTATISTICS_H
+
+#include <aalwines/utils/system.h>
+
+#include <chrono>
+
+#include <nlohmann/json.hpp>
+
+namespace aalwines {
+
+    /**
+     * Per-iteration statistics of a CEGAR run, written to json_output["iterations"] while the run progresses,
+     * so the iterations completed before a timeout are still reported.
+     * Each iteration records the seconds spent in each phase, the size of the abstract PDA,
+     * the kind of refinement that ended it (null for the last iteration) and the resident memory of the process when it ended.
+     * The solver runs inside pdaaal, so its time is measured from the end of build_pda to the start of the reconstruction.
+     */
+    class CegarStatistics {
+        using json = nlohmann::json;
+        using clock = std::chrono::steady_clock;
+    public:
+        enum class phase_t { NONE, BUILD_PDA, SOLVER, RECONSTRUCTION, FIND_REFINEMENT, REFINE };
+
+        // Enters a phase for its lifetime, and returns to the previous phase afterwards.
+        class scope {
+        public:
+            scope(CegarStatistics* statistics, phase_t phase) : _statistics(statistics) {
+                if (_statistics != nullptr) _previous = _statistics->enter(phase);
+            }
+            ~scope() {
+                if (_statistics != nullptr) _statistics->enter(_previous);
+            }
+            scope(const scope&) = delete;
+            scope& operator=(const scope&) = delete;
+        private:
+            CegarStatistics* _statistics;
+            phase_t _previous = phase_t::NONE;
+        };
+
+        explicit CegarStatistics(json& json_output) : _json_output(json_output) {
+            _json_output["iterations"] = json::array();
+        }
+
+        // Closes the current phase and returns it. Entering BUILD_PDA starts a new iteration.
+        phase_t enter(phase_t phase) {
+            auto now = clock::now();
+            auto previous = _phase;
+            if (_phase != phase_t::NONE) {
+                auto& field = current()[name(_phase)];
+                field = field.get<double>() + std::chrono::duration<double>(now - _start).count();
+            }
+            if (phase == phase_t::BUILD_PDA) {
+                end_iteration();
+                _json_output["iterations"].push_back(json{{"build_pda", 0.0}, {"solver", 0.0}, {"reconstruction", 0.0}, {"find_refinement", 0.0},
+                                                          {"refine", 0.0}, {"refinement", nullptr}});
+                _open = true;
+            }
+            _phase = phase;
+            _start = now;
+            return previous;
+        }
+        // Call when the CEGAR run is over, also when it ended with an exception.
+        void finish() {
+            enter(phase_t::NONE);
+            end_iteration();
+        }
+
+        void pda_size(size_t rules, size_t states, size_t labels, size_t interfaces) {
+            if (!_open) return;
+            auto& iteration = current();
+            iteration["rules"] = rules;
+            iteration["states"] = states;
+            iteration["labels"] = labels;
+            iteration["interfaces"] = interfaces;
+        }
+        // One of "interface", "label", "interface_and_label", "spurious_rule" or "header".
+        void refinement(const char* kind) {
+            if (_open) current()["refinement"] = kind;
+        }
+
+    private:
+        json& current() { return _json_output["iterations"].back(); }
+        void end_iteration() {
+            if (!_open) return;
+            current()["resident_memory"] = resident_memory();
+            _open = false;
+        }
+        static const char* name(phase_t phase) {
+            switch (phase) {
+                case phase_t::BUILD_PDA:
+                    return "build_pda";
+                case phase_t::SOLVER:
+                    return "solver";
+                case phase_t::RECONSTRUCTION:
+                    return "reconstruction";
+                case phase_t::FIND_REFINEMENT:
+                    return "find_refinement";
+                default:
+                    return "refine";
+            }
+        }
+
+        json& _json_output;
+        phase_t _phase = phase_t::NONE;
+        clock::time_point _start;
+        bool _open = false; // An iteration has been started and not yet ended.
+    };
+
+}
+
+#endif //AALWINES_CEGARSTATISTICS_H
@@ -28,24 +28,35 @@
 #define AALWINES_CEGARVERIFIER_H
 
 #include "CegarNetworkPdaFactory.h"
+#include "LabelDictionary.h"
+#include <aalwines/utils/flat_id_set.h>
+#include <aalwines/utils/work_stealing_pool.h>
 #include <pdaaal/Solver.h>
 
+#include <exception>
+#include <map>
+
 namespace aalwines {
 
     class CegarVerifier {
     public:
+        // If initial_abstraction fits the network, the initial abstraction is refined to be at least as fine as it.
+        // If final_abstraction is not nullptr, it is set to the abstraction of the last iteration (also when the budget is exceeded).
+        // If seed_header_labels is false, the labels of the header NFAs start in their next-hop group like all other labels.
         template<bool no_abstraction = false, bool use_pre_star = false, pdaaal::refinement_option_t refinement_option = pdaaal::refinement_option_t::best_refinement, bool use_dual = false>
-        static std::optional<json> verify(const Network &network, Query& query, std::unordered_set<Query::label_t>&& all_labels, json& json_output) {
+        static std::optional<json> verify(const CompiledNetwork& compiled, Query& query, const LabelDictionary& labels, json& json_output, const utils::query_budget* budget = nullptr, size_t threads = 1,
+                                          const CegarAbstraction* initial_abstraction = nullptr, CegarAbstraction* final_abstraction = nullptr,
+                                          bool seed_header_labels = true) {
+            const auto& network = compiled.network();
             query.compile_nfas();
             // TODO: Weights
             if constexpr (no_abstraction) {
-                CegarNetworkPdaFactory<> factory(json_output, network, query, std::move(all_labels),
+                CegarNetworkPdaFactory<> factory(json_output, compiled, query, labels.label_set(),
                                                  [](const Query::label_t& label) -> Query::label_t { return label; },
                                                  [](const Interface* inf){ return inf->global_id();});
-                pdaaal::CEGAR<CegarNetworkPdaFactory<>,CegarNetworkPdaReconstruction<refinement_option>> cegar;
-                auto res = cegar.template cegar_solve<use_pre_star,use_dual>(std::move(factory), query.construction(), query.destruction());
-                if (res) return std::move(res).value().get();
-                return std::nullopt;
+                factory.set_budget(budget);
+                if (final_abstraction != nullptr) factory.set_abstraction_output(final_abstraction, labels);
+                return solve<use_pre_star,refinement_option,use_dual>(std::move(factory), query, json_output);
             } else {
                 // Identify edges in the path NFA that explicitly mentions an interface. Use this for initial abstraction.
                 using edge_t = const typename pdaaal::NFA<Query::label_t>::edge_t*;
@@ -58,58 +69,162 @@ namespace aalwines {
                         }
                     }
                 }
-                // TODO: Do the same with labels mentioned in initial and final NFAs.
-
                 // We distinguish labels based on the next hops that it leads to.
-                std::unordered_map<Query::label_t, std::unordered_set<const Interface*>> label_to_next_hops;
-                for (const auto& router : network.routers()) {
-                    for (const auto& table : router->tables()) {
-                        for (const auto& entry : table->entries()) {
-                            for (const auto& forward : entry._rules) {
-                                if (forward._priority > query.number_of_failures()) continue; // TODO: Approximation here.
-                                label_to_next_hops.try_emplace(entry._top_label).first->second.emplace(forward._via);
+                auto label_map = next_hop_label_partition(network, query, labels, threads, budget);
+                size_t next_hop_groups = 0;
+                for (auto id : label_map) {
+                    if (id != std::numeric_limits<size_t>::max()) next_hop_groups = std::max(next_hop_groups, id + 1);
+                }
+                // Labels mentioned explicitly in the initial and final header NFAs are usually refined away from their group
+                // in the first iterations, so each of them gets its own abstract label up front.
+                std::unordered_map<Query::label_t, size_t> header_labels;
+                for (const auto* nfa : {&query.construction(), &query.destruction()}) {
+                    for (const auto& state : nfa->states()) {
+                        for (const auto& edge : state->_edges) {
+                            for (const auto& symbol : edge._symbols) {
+                                if (seed_header_labels && labels.contains(symbol)) header_labels.try_emplace(symbol, header_labels.size());
                             }
                         }
                     }
                 }
-                // This is a bit slow, but it's okay for now..
-                std::vector<std::vector<const Interface*>> next_hops_set;
-                std::unordered_map<Query::label_t, size_t> label_map;
-                for (const auto& [label, nh_set] : label_to_next_hops) {
-                    std::vector<const Interface*> next_hops(nh_set.begin(), nh_set.end());
-                    std::sort(next_hops.begin(), next_hops.end());
-                    auto it = std::find(next_hops_set.begin(), next_hops_set.end(), next_hops);
-                    label_map.emplace(label, it - next_hops_set.begin());
-                    if (it == next_hops_set.end()) {
-                        next_hops_set.emplace_back(std::move(next_hops));
-                    }
-                }
+                json_output["seeded_labels"] = header_labels.size();
+
+                // A saved abstraction (from an earlier run of the same query on the same network) is combined with the abstraction above, so the initial abstraction
+                // is at least as fine as both. The abstract values are pairs of (value from above, saved abstract id), numbered in order of appearance.
+                bool warm_start = initial_abstraction != nullptr && initial_abstraction->fits(network.all_interfaces().size(), labels.size());
+                json_output["warm_start"] = warm_start;
+                std::map<std::pair<size_t,size_t>, size_t> label_keys;
+                std::map<std::pair<std::vector<edge_t>,size_t>, size_t> interface_keys;
 
-                CegarNetworkPdaFactory<> factory(json_output, network, query, std::move(all_labels),
-                    [&label_map](const auto& label) -> size_t {
+                CegarNetworkPdaFactory<> factory(json_output, compiled, query, labels.label_set(),
+                    [&label_map,&labels,&header_labels,next_hop_groups,warm_start,initial_abstraction,&label_keys](const auto& label) -> size_t {
+                        size_t value;
                         switch (label) { // Special labels map to distinct values, but all normal labels in the network maps to the same abstract label.
                             case Query::unused_label():
-                                return 0;
+                                value = 0;
+                                break;
                             case Query::bottom_of_stack():
-                                return 1;
+                                value = 1;
+                                break;
                             default:
-                                auto it = label_map.find(label);
-                                return (it == label_map.end() ? 2 : it->second + 3);
+                                if (auto it = header_labels.find(label); it != header_labels.end()) {
+                                    value = it->second + next_hop_groups + 3;
+                                    break;
+                                }
+                                auto id = labels.id(label);
+                                value = (!id || label_map[id.value()] == std::numeric_limits<size_t>::max()) ? 2 : label_map[id.value()] + 3;
                         }
+                        if (!warm_start) return value;
+                        auto id = labels.id(label);
+                        auto saved = id ? initial_abstraction->_labels[id.value()] : CegarAbstraction::none();
+                        return label_keys.try_emplace(std::make_pair(value, saved), label_keys.size()).first->second;
                     },
-                    [&inf_map](const Interface* inf) -> std::vector<edge_t> {
+                    [&inf_map,warm_start,initial_abstraction,&interface_keys](const Interface* inf) -> size_t {
                         // Use the NFA edges that explicitly mentions inf as the 'abstract state', i.e. group together interfaces that are mentioned similarly.
                         auto it = inf_map.find(inf);
-                        return (it == inf_map.end()) ? std::vector<edge_t>() : it->second;
+                        auto edges = (it == inf_map.end()) ? std::vector<edge_t>() : it->second;
+                        auto saved = warm_start ? initial_abstraction->_interfaces[inf->global_id()] : CegarAbstraction::none();
+                        return interface_keys.try_emplace(std::make_pair(std::move(edges), saved), interface_keys.size()).first->second;
                     }
                 );
-                pdaaal::CEGAR<CegarNetworkPdaFactory<>,CegarNetworkPdaReconstruction<refinement_option>> cegar;
+                factory.set_budget(budget);
+                if (final_abstraction != nullptr) factory.set_abstraction_output(final_abstraction, labels);
+                return solve<use_pre_star,refinement_option,use_dual>(std::move(factory), query, json_output);
+            }
+        }
+
+        // Gives labels with the same set of next hops (over rules with _priority <= number of failures) the same id in [0, number of sets).
+        // Labels that are not matched by any entry get std::numeric_limits<size_t>::max(). Indexed by label id.
+        // The tables are scanned concurrently, but ids are assigned in order of label id, so the result does not depend on threads.
+        static std::vector<size_t> next_hop_label_partition(const Network& network, const Query& query, const LabelDictionary& labels,
+                                                            size_t threads = 1, const utils::query_budget* budget = nullptr) {
+            using label_next_hop_t = std::pair<size_t, const Interface*>; // (label id, next hop)
+            auto scan = [&network, &query, &labels, budget](size_t router_begin, size_t router_end, std::vector<label_next_hop_t>& result) {
+                for (auto router_i = router_begin; router_i < router_end; ++router_i) {
+                    utils::query_budget::check(budget);
+                    for (const auto& table : network.routers()[router_i]->tables()) {
+                        for (const auto& entry : table->entries()) {
+                            if (entry.ignores_label()) continue;
+                            auto label_id = labels.id(entry._top_label).value();
+                            for (const auto& forward : entry._rules) {
+                                if (forward._priority > query.number_of_failures()) continue; // TODO: Approximation here.
+                                result.emplace_back(label_id, forward._via);
+                            }
+                        }
+                    }
+                }
+            };
+            std::vector<label_next_hop_t> label_next_hops;
+            auto routers = network.routers().size();
+            if (threads <= 1 || routers < 2) {
+                scan(0, routers, label_next_hops);
+            } else {
+                utils::work_stealing_pool pool(threads);
+                auto chunks = std::min(routers, pool.size() * 4);
+                std::vector<std::vector<label_next_hop_t>> results(chunks);
+                std::vector<std::exception_ptr> errors(chunks);
+                for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                    pool.submit([&, chunk](){
+                        try {
+                            scan(routers * chunk / chunks, routers * (chunk + 1) / chunks, results[chunk]);
+                        } catch (...) {
+                            errors[chunk] = std::current_exception();
+                        }
+                    });
+                }
+                pool.wait();
+                for (const auto& error : errors) {
+                    if (error) std::rethrow_exception(error);
+                }
+                for (auto& result : results) {
+                    label_next_hops.insert(label_next_hops.end(), result.begin(), result.end());
+                }
+            }
+            // Sort, so the next hops of a label are a sorted run without duplicates, i.e. a canonical signature.
+            std::sort(label_next_hops.begin(), label_next_hops.end());
+            label_next_hops.erase(std::unique(label_next_hops.begin(), label_next_hops.end()), label_next_hops.end());
+
+            std::unordered_map<std::vector<const Interface*>, size_t, next_hops_hash> signature_ids;
+            std::vector<size_t> label_map(labels.size(), std::numeric_limits<size_t>::max());
+            std::vector<const Interface*> next_hops;
+            for (auto it = label_next_hops.begin(); it != label_next_hops.end(); ) {
+                auto label_id = it->first;
+                next_hops.clear();
+                for (; it != label_next_hops.end() && it->first == label_id; ++it) {
+                    next_hops.push_back(it->second);
+                }
+                auto id = signature_ids.size();
+                label_map[label_id] = signature_ids.try_emplace(next_hops, id).first->second;
+            }
+            return label_map;
+        }
+
+    private:
+        template<bool use_pre_star, pdaaal::refinement_option_t refinement_option, bool use_dual>
+        static std::optional<json> solve(CegarNetworkPdaFactory<>&& factory, Query& query, json& json_output) {
+            CegarStatistics statistics(json_output);
+            factory.set_statistics(&statistics);
+            pdaaal::CEGAR<CegarNetworkPdaFactory<>,CegarNetworkPdaReconstruction<refinement_option>> cegar;
+            try {
                 auto res = cegar.template cegar_solve<use_pre_star,use_dual>(std::move(factory), query.construction(), query.destruction());
+                statistics.finish();
                 if (res) return std::move(res).value().get();
                 return std::nullopt;
+            } catch (...) { // Keep the statistics of the iterations so far, e.g. when the budget is exceeded.
+                statistics.finish();
+                throw;
             }
         }
 
+        struct next_hops_hash {
+            size_t operator()(const std::vector<const Interface*>& next_hops) const {
+                uint64_t hash = next_hops.size();
+                for (const auto& inf : next_hops) {
+                    hash = utils::mix_hash(hash ^ reinterpret_cast<uintptr_t>(inf));
+                }
+                return hash;
+            }
+        };
     };
 
 }
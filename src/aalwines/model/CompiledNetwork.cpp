@@ -0,0 +1,92 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   CompiledNetwork.cpp
+ *
+ * Created on 17-10-2026.
+ */
+
+#include "CompiledNetwork.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace aalwines {
+
+    CompiledNetwork::CompiledNetwork(const Network& network, const RuleTemplates& templates)
+    : _network(network), _templates(templates) {
+        _interfaces = network.all_interfaces();
+        _interface_router.resize(_interfaces.size(), none());
+        _interface_table.resize(_interfaces.size(), none());
+        _interface_match.resize(_interfaces.size(), none());
+
+        _router_interfaces_begin.push_back(0);
+        _router_tables_begin.push_back(0);
+        _table_entries_begin.push_back(0);
+        _entry_rules_begin.push_back(0);
+        _table_out_interfaces_begin.push_back(0);
+        for (size_t router_id = 0; router_id < network.routers().size(); ++router_id) {
+            const auto& router = network.routers()[router_id];
+            for (const auto& inf : router->interfaces()) {
+                _router_interfaces.push_back(inf->global_id());
+                _interface_router[inf->global_id()] = router_id;
+                if (inf->match() != nullptr) _interface_match[inf->global_id()] = inf->match()->global_id();
+            }
+            _router_interfaces_begin.push_back(_router_interfaces.size());
+            // Same order as the table ids of RuleTemplates, so the entries of a table are followed by exactly its rule templates.
+            for (const auto& table : router->tables()) {
+                auto table_id = _tables.size();
+                assert(templates.table(table.get())._table_id == table_id);
+                _tables.push_back(table.get());
+                _table_router.push_back(router_id);
+                _router_tables.push_back(table_id);
+                for (const auto& inf : table->interfaces()) {
+                    _interface_table[inf->global_id()] = table_id;
+                }
+                for (const auto& inf : table->out_interfaces()) {
+                    _table_out_interfaces.push_back(inf->global_id());
+                }
+                std::sort(_table_out_interfaces.begin() + _table_out_interfaces_begin.back(), _table_out_interfaces.end());
+                _table_out_interfaces_begin.push_back(_table_out_interfaces.size());
+                for (const auto& entry : table->entries()) {
+                    _entry_top_label.push_back(entry._top_label);
+                    _entry_rules_begin.push_back(_entry_rules_begin.back() + entry._rules.size());
+                }
+                _table_entries_begin.push_back(_entry_top_label.size());
+            }
+            _router_tables_begin.push_back(_router_tables.size());
+        }
+        assert(_entry_rules_begin.back() == templates.size());
+
+        _rule_target.reserve(templates.size());
+        _rule_target_table.reserve(templates.size());
+        _rule_target_edge.reserve(templates.size());
+        for (const auto& rule : templates.templates()) {
+            const Interface* target = rule._via->match();
+            if (target == nullptr) {
+                _rule_target.push_back(none());
+                _rule_target_table.push_back(none());
+                _rule_target_edge.emplace_back(static_cast<const Interface*>(nullptr));
+            } else {
+                _rule_target.push_back(target->global_id());
+                _rule_target_table.push_back(_interface_table[target->global_id()]);
+                _rule_target_edge.push_back(NetworkTranslation::get_edge_pointer(target));
+            }
+        }
+    }
+
+}
@@ -0,0 +1,132 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   CompiledNetwork.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_COMPILEDNETWORK_H
+#define AALWINES_COMPILEDNETWORK_H
+
+#include <aalwines/model/Network.h>
+#include <aalwines/model/NetworkTranslation.h>
+#include <aalwines/model/RuleTemplates.h>
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace aalwines {
+
+    /**
+     * Immutable, flat copy of the topology and forwarding rules of a pre-processed network.
+     * Routers, interfaces and tables are identified by dense ids: Router::index(), Interface::global_id() and the table ids of RuleTemplates.
+     * One-to-many relations are contiguous (CSR) arrays: routers -> interfaces, routers -> tables, tables -> out interfaces and tables -> entries -> rules.
+     * The rules are the rule templates, so per-rule arrays are indexed by RuleTemplates::index().
+     * The PDA constructions read the targets of forwarding rules from here instead of following Interface and RoutingTable pointers.
+     * Built once per network and shared (read-only) by all queries, see Builder::compiled_network().
+     */
+    class CompiledNetwork {
+    public:
+        using label_t = Query::label_t;
+        using edge_variant = NetworkTranslation::edge_variant;
+        static constexpr size_t none() noexcept { return std::numeric_limits<size_t>::max(); }
+
+        struct id_range_t {
+            const size_t* _begin;
+            const size_t* _end;
+            [[nodiscard]] const size_t* begin() const { return _begin; }
+            [[nodiscard]] const size_t* end() const { return _end; }
+            [[nodiscard]] size_t size() const { return _end - _begin; }
+            [[nodiscard]] bool empty() const { return _begin == _end; }
+        };
+        struct index_range_t { // [_begin, _end)
+            size_t _begin;
+            size_t _end;
+        };
+
+        CompiledNetwork(const Network& network, const RuleTemplates& templates);
+
+        [[nodiscard]] const Network& network() const { return _network; }
+        [[nodiscard]] const RuleTemplates& templates() const { return _templates; }
+        [[nodiscard]] size_t number_of_routers() const { return _router_interfaces_begin.size() - 1; }
+        [[nodiscard]] size_t number_of_interfaces() const { return _interfaces.size(); }
+        [[nodiscard]] size_t number_of_tables() const { return _tables.size(); }
+        [[nodiscard]] size_t number_of_entries() const { return _entry_top_label.size(); }
+
+        // Routers
+        [[nodiscard]] id_range_t router_interfaces(size_t router) const { return range(_router_interfaces, _router_interfaces_begin, router); }
+        [[nodiscard]] id_range_t router_tables(size_t router) const { return range(_router_tables, _router_tables_begin, router); }
+
+        // Interfaces. Missing tables and matches are none().
+        [[nodiscard]] const Interface* interface(size_t id) const { return _interfaces[id]; }
+        [[nodiscard]] size_t interface_router(size_t id) const { return _interface_router[id]; }
+        [[nodiscard]] size_t interface_table(size_t id) const { return _interface_table[id]; }
+        [[nodiscard]] size_t interface_match(size_t id) const { return _interface_match[id]; }
+
+        // Tables. The out interfaces are sorted by global id.
+        [[nodiscard]] const RoutingTable* table(size_t id) const { return _tables[id]; }
+        [[nodiscard]] size_t table_router(size_t id) const { return _table_router[id]; }
+        [[nodiscard]] id_range_t table_out_interfaces(size_t id) const { return range(_table_out_interfaces, _table_out_interfaces_begin, id); }
+        [[nodiscard]] index_range_t table_entries(size_t id) const { return {_table_entries_begin[id], _table_entries_begin[id + 1]}; }
+
+        // Entries are numbered in the order of the tables and table->entries(). Their rules are rule template indices.
+        [[nodiscard]] label_t entry_top_label(size_t entry) const { return _entry_top_label[entry]; }
+        [[nodiscard]] index_range_t entry_rules(size_t entry) const { return {_entry_rules_begin[entry], _entry_rules_begin[entry + 1]}; }
+
+        // Forwarding rules, by rule template index.
+        // The interface at the other end of _via, the table of that interface, and the edge state that the PDA construction uses for it.
+        [[nodiscard]] size_t rule_target(size_t rule) const { return _rule_target[rule]; }
+        [[nodiscard]] size_t rule_target_table(size_t rule) const { return _rule_target_table[rule]; }
+        [[nodiscard]] const edge_variant& rule_target_edge(size_t rule) const { return _rule_target_edge[rule]; }
+
+    private:
+        static id_range_t range(const std::vector<size_t>& ids, const std::vector<size_t>& begin, size_t i) {
+            return id_range_t{ids.data() + begin[i], ids.data() + begin[i + 1]};
+        }
+
+        const Network& _network;
+        const RuleTemplates& _templates;
+
+        std::vector<size_t> _router_interfaces;       // Interface ids of router i are in [_router_interfaces_begin[i], _router_interfaces_begin[i+1])
+        std::vector<size_t> _router_interfaces_begin;
+        std::vector<size_t> _router_tables;           // Likewise for table ids.
+        std::vector<size_t> _router_tables_begin;
+
+        std::vector<const Interface*> _interfaces;
+        std::vector<size_t> _interface_router;
+        std::vector<size_t> _interface_table;
+        std::vector<size_t> _interface_match;
+
+        std::vector<const RoutingTable*> _tables;
+        std::vector<size_t> _table_router;
+        std::vector<size_t> _table_out_interfaces;
+        std::vector<size_t> _table_out_interfaces_begin;
+        std::vector<size_t> _table_entries_begin;
+
+        std::vector<label_t> _entry_top_label;
+        std::vector<size_t> _entry_rules_begin;
+
+        std::vector<size_t> _rule_target;
+        std::vector<size_t> _rule_target_table;
+        std::vector<edge_variant> _rule_target_edge;
+    };
+
+}
+
+#endif //AALWINES_COMPILEDNETWORK_H
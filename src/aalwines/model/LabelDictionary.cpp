@@ -0,0 +1,70 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   LabelDictionary.cpp
+ *
+ * Created on 17-10-2026.
+ */
+
+#include "LabelDictionary.h"
+
+#include <algorithm>
+
+namespace aalwines {
+
+    LabelDictionary::LabelDictionary(const Network& network) {
+        std::vector<label_t> labels;
+        for (const auto& r : network.routers()) {
+            for (const auto& table : r->tables()) {
+                for (const auto& e : table->entries()) {
+                    if (!e.ignores_label()) labels.push_back(e._top_label);
+                    for (const auto& f : e._rules) {
+                        for (const auto& o : f._ops) {
+                            switch (o._op) {
+                                case RoutingTable::op_t::SWAP:
+                                case RoutingTable::op_t::PUSH:
+                                    labels.push_back(o._op_label);
+                                default:
+                                    break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        std::sort(labels.begin(), labels.end());
+        labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+        labels.erase(std::remove_if(labels.begin(), labels.end(), [](label_t label){
+            return label == Query::unused_label() || label == Query::bottom_of_stack();
+        }), labels.end());
+
+        _labels.reserve(labels.size() + 2);
+        _labels.push_back(Query::unused_label()); // This label will 'match' any label in the query that is not present in the network.
+        _labels.push_back(Query::bottom_of_stack()); // This label is used in the PDA construction to represent the bottom of the stack.
+        _labels.insert(_labels.end(), labels.begin(), labels.end());
+        _label_set = labelset_t(_labels.begin(), _labels.end());
+    }
+
+    std::optional<size_t> LabelDictionary::id(label_t label) const {
+        if (label == Query::unused_label()) return unused_id();
+        if (label == Query::bottom_of_stack()) return bottom_of_stack_id();
+        if (_labels.size() <= 2) return std::nullopt;
+        auto it = std::lower_bound(_labels.begin() + 2, _labels.end(), label);
+        if (it == _labels.end() || *it != label) return std::nullopt;
+        return it - _labels.begin();
+    }
+
+}
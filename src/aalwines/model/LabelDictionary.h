@@ -0,0 +1,69 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   LabelDictionary.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_LABELDICTIONARY_H
+#define AALWINES_LABELDICTIONARY_H
+
+#include <aalwines/model/Network.h>
+#include <aalwines/model/Query.h>
+
+#include <optional>
+#include <unordered_set>
+#include <vector>
+
+namespace aalwines {
+
+    /**
+     * Immutable dictionary of all labels used in a network, built once and shared (read-only) by all queries.
+     * Labels get dense ids: the special labels are pre-assigned unused_id() and bottom_of_stack_id(),
+     * followed by the labels of the network in sorted order.
+     *
+     * What this saves is the per-query rebuild of the label set in aalwines (Builder::all_labels() now returns a
+     * reference). It does not save the copy made by pdaaal: every pdaaal factory still copies and hashes the set it is
+     * given, so per-query setup time and peak memory of the PDA construction are unchanged by this class.
+     */
+    class LabelDictionary {
+    public:
+        using label_t = Query::label_t;
+        using labelset_t = std::unordered_set<label_t>;
+
+        explicit LabelDictionary(const Network& network);
+
+        static constexpr size_t unused_id() noexcept { return 0; }
+        static constexpr size_t bottom_of_stack_id() noexcept { return 1; }
+
+        [[nodiscard]] size_t size() const { return _labels.size(); }
+        [[nodiscard]] label_t label(size_t id) const { return _labels[id]; }
+        [[nodiscard]] const std::vector<label_t>& labels() const { return _labels; }
+        [[nodiscard]] std::optional<size_t> id(label_t label) const;
+        [[nodiscard]] bool contains(label_t label) const { return id(label).has_value(); }
+
+        // The same labels as a set, which is the format pdaaal takes. Each pdaaal factory copies it (see above).
+        [[nodiscard]] const labelset_t& label_set() const { return _label_set; }
+
+    private:
+        std::vector<label_t> _labels;
+        labelset_t _label_set;
+    };
+
+}
+
+#endif //AALWINES_LABELDICTIONARY_H
@@ -0,0 +1,146 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   LabelFlow.cpp
+ *
+ * Created on 17-10-2026.
+ */
+
+#include "LabelFlow.h"
+
+#include <iterator>
+
+namespace aalwines {
+
+    void LabelFlow::labels_t::insert(label_t label) {
+        if (_any) return;
+        auto it = std::lower_bound(_labels.begin(), _labels.end(), label);
+        if (it == _labels.end() || *it != label) _labels.insert(it, label);
+    }
+
+    bool LabelFlow::labels_t::merge(const labels_t& other) {
+        if (_any) return false;
+        if (other._any) {
+            _any = true;
+            _stack = false;
+            _labels.clear();
+            return true;
+        }
+        bool changed = other._stack && !_stack;
+        _stack = _stack || other._stack;
+        auto size = _labels.size();
+        if (!other._labels.empty()) {
+            std::vector<label_t> merged;
+            std::set_union(_labels.begin(), _labels.end(), other._labels.begin(), other._labels.end(), std::back_inserter(merged));
+            _labels.swap(merged);
+        }
+        return changed || _labels.size() != size;
+    }
+
+    LabelFlow::labels_t LabelFlow::after(pdaaal::op_t op, label_t op_label, labels_t before, const labels_t& stack) {
+        switch (op) {
+            case pdaaal::PUSH:
+            case pdaaal::SWAP:
+                return labels_t{false, false, {op_label}};
+            case pdaaal::POP:
+                return labels_t{stack._any, !stack._any, {}};
+            default:
+                return before;
+        }
+    }
+
+    std::pair<LabelFlow::labels_t,LabelFlow::labels_t> LabelFlow::header_labels(const RuleTemplates& templates, const NFA& construction) {
+        auto add_edge = [](labels_t& labels, const NFA::edge_t& e) {
+            if (e._negated) {
+                labels._any = true;
+                labels._labels.clear();
+            } else {
+                for (const auto& symbol : e._symbols) labels.insert(symbol);
+            }
+        };
+        // Labels that can be on the stack.
+        labels_t stack;
+        for (const auto& state : construction.states()) {
+            for (const auto& e : state->_edges) add_edge(stack, e);
+        }
+        for (const auto& forward : templates.templates()) {
+            if (forward._op == pdaaal::PUSH || forward._op == pdaaal::SWAP) stack.insert(forward._op_label);
+        }
+        for (size_t suffix = RuleTemplates::empty_op_suffix() + 1; suffix < templates.number_of_op_suffixes(); ++suffix) {
+            auto [op, op_label] = templates.op_suffix_head(suffix);
+            if (op == pdaaal::PUSH || op == pdaaal::SWAP) stack.insert(op_label);
+        }
+        stack.insert(Query::bottom_of_stack());
+
+        // Labels on top of the stack initially.
+        labels_t initial;
+        for (const auto& state : construction.initial()) {
+            for (const auto& e : state->_edges) {
+                if (!e._negated && e._symbols.empty()) { // Epsilon edge, fall back to any label of the stack.
+                    return std::make_pair(stack, labels_t{stack._any, !stack._any, {}});
+                }
+                add_edge(initial, e);
+            }
+        }
+        return std::make_pair(std::move(stack), std::move(initial));
+    }
+
+    LabelFlow::LabelFlow(const RuleTemplates& templates, const NFA& construction, const std::vector<const Interface*>& initial,
+                         size_t max_priority, const utils::query_budget* budget)
+    : _templates(templates), _tops(templates.number_of_tables()) {
+        auto [stack, initial_labels] = header_labels(templates, construction);
+        _stack = std::move(stack);
+
+        std::vector<size_t> waiting;
+        std::vector<bool> queued(_tops.size(), false);
+        auto reach = [&](const RoutingTable* table, const labels_t& labels) {
+            if (table == nullptr) return;
+            auto id = templates.table(table)._table_id;
+            if (_tops[id].merge(labels) && !queued[id]) {
+                queued[id] = true;
+                waiting.push_back(id);
+            }
+        };
+        for (const auto& inf : initial) {
+            if (inf != nullptr) reach(inf->table(), initial_labels);
+        }
+        while (!waiting.empty()) {
+            utils::query_budget::check(budget);
+            auto id = waiting.back();
+            waiting.pop_back();
+            queued[id] = false;
+            auto current = _tops[id];
+            for (const auto& forward : templates.table(id)) {
+                if (forward._priority > max_priority || forward._via == nullptr || forward._via->match() == nullptr) continue;
+                labels_t labels;
+                if (forward._pre == Query::wildcard_label()) {
+                    labels = after(forward._op, forward._op_label, current, _stack);
+                } else if (current.contains(forward._pre, _stack)) {
+                    labels = after(forward._op, forward._op_label, labels_t{false, false, {forward._pre}}, _stack);
+                } else {
+                    continue;
+                }
+                for (auto ops = forward._op_suffix; ops != RuleTemplates::empty_op_suffix(); ops = templates.op_suffix_tail(ops)) {
+                    const auto& [op, op_label] = templates.op_suffix_head(ops);
+                    labels = after(op, op_label, std::move(labels), _stack);
+                }
+                reach(forward._via->match()->table(), labels);
+            }
+        }
+    }
+
+}
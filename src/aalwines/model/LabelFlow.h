@@ -0,0 +1,87 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   LabelFlow.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_LABELFLOW_H
+#define AALWINES_LABELFLOW_H
+
+#include <aalwines/model/Network.h>
+#include <aalwines/model/Query.h>
+#include <aalwines/model/RuleTemplates.h>
+#include <aalwines/utils/query_budget.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace aalwines {
+
+    /**
+     * Over-approximation of the labels that can be on top of the stack when a packet reaches each routing table,
+     * given the construction NFA of a query. It is a fixpoint over the tables: the initial labels reach the tables
+     * of the initial interfaces, and a forwarding rule (with _priority <= max_priority) whose label can reach its table
+     * passes the label after its operations on to the table of the next hop.
+     * After a pop, any label that can be on the stack may be on top: the labels of the construction NFA,
+     * the labels pushed or swapped by the network, and the bottom of stack.
+     * Entries for labels that cannot reach their table are never used, so the PDA construction can leave them out.
+     */
+    class LabelFlow {
+    public:
+        using label_t = Query::label_t;
+        using NFA = pdaaal::NFA<label_t>;
+
+        LabelFlow(const RuleTemplates& templates, const NFA& construction, const std::vector<const Interface*>& initial,
+                  size_t max_priority, const utils::query_budget* budget = nullptr);
+
+        [[nodiscard]] bool may_reach(size_t table_id, label_t label) const {
+            return _tops[table_id].contains(label, _stack);
+        }
+        [[nodiscard]] bool may_reach(const RoutingTable* table, label_t label) const {
+            return may_reach(_templates.table(table)._table_id, label);
+        }
+
+        // A set of labels, where _any means all labels, and _stack means all labels that can be on the stack.
+        struct labels_t {
+            bool _any = false;
+            bool _stack = false;
+            std::vector<label_t> _labels; // Sorted
+
+            [[nodiscard]] bool contains(label_t label, const labels_t& stack) const {
+                return _any || std::binary_search(_labels.begin(), _labels.end(), label) || (_stack && stack.contains(label, stack));
+            }
+            void insert(label_t label);
+            bool merge(const labels_t& other); // Returns whether any labels were added.
+        };
+        // The labels that can be on the stack (never with _stack set), and the labels on top of the stack initially.
+        // Also used by the lazy PDA construction, which follows the top labels per PDA state instead of per table.
+        static std::pair<labels_t,labels_t> header_labels(const RuleTemplates& templates, const NFA& construction);
+        // The labels on top of the stack after op, given the labels on top before it.
+        static labels_t after(pdaaal::op_t op, label_t op_label, labels_t before, const labels_t& stack);
+
+    private:
+        const RuleTemplates& _templates;
+        labels_t _stack; // Never has _stack set.
+        std::vector<labels_t> _tops; // Indexed by table id
+    };
+
+}
+
+#endif //AALWINES_LABELFLOW_H
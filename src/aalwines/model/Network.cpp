@@ -26,7 +26,9 @@
 
 #include "Network.h"
 #include "filter.h"
+#include <aalwines/utils/more_algorithms.h>
 
+#include <algorithm>
 #include <cassert>
 #include <map>
 
@@ -382,12 +384,35 @@ namespace aalwines {
                 table->sort_rules();
             }
         }
+        identify_edges();
     }
 
     void Network::pre_process(std::ostream& log) {
         for (const auto& router : _routers) {
             router->pre_process(log);
         }
+        identify_edges();
+    }
+
+    void Network::identify_edges() {
+        // The edge (inf->match(), inf) is reached from a table t of inf->target() with inf->match() in t->out_interfaces().
+        // If inf is the only interface of inf->table() that is reachable from these tables, then inf->table() identifies the edge.
+        for (const auto& router : _routers) {
+            for (const auto& inf : router->interfaces()) {
+                if (inf->table() == nullptr || inf->match() == nullptr || inf->target() == nullptr) {
+                    inf->set_edge_identification(Interface::edge_identification_t::UNKNOWN);
+                    continue;
+                }
+                auto out_infs = utils::flat_union_if(inf->target()->tables(),
+                    [](const auto& table){ return table->out_interfaces(); },
+                    [match=inf->match()](const auto& table){ return utils::sorted_contains(table->out_interfaces(), match); }
+                );
+                auto reachable = std::count_if(inf->table()->interfaces().begin(), inf->table()->interfaces().end(), [&out_infs](const Interface* other){
+                    return utils::sorted_contains(out_infs, other->match());
+                });
+                inf->set_edge_identification(reachable == 1 ? Interface::edge_identification_t::TABLE : Interface::edge_identification_t::INTERFACE);
+            }
+        }
     }
 
 }
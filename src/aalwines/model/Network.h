@@ -96,6 +96,7 @@ namespace aalwines {
         // Remove redundant rules.
         void pre_process(std::ostream& log = std::cerr);
         void prepare_tables(); // Sets up data structures in tables. Use if tables were modified. Use before pre_process.
+        void identify_edges(); // Sets Interface::edge_identification() for all interfaces. Done by prepare_tables and pre_process.
 
         void inject_network(Interface* link, Network&& nested_network, Interface* nested_ingoing,
                             Interface* nested_outgoing, RoutingTable::label_t pre_label, RoutingTable::label_t post_label);
@@ -29,11 +29,74 @@
 
 #include <aalwines/model/Query.h>
 #include <aalwines/model/Network.h>
+#include <aalwines/model/CompiledNetwork.h>
+#include <aalwines/model/LabelFlow.h>
 #include <aalwines/model/NetworkTranslation.h>
+#include <aalwines/model/PathReachability.h>
+#include <aalwines/model/RuleTemplates.h>
+#include <aalwines/utils/flat_id_set.h>
+#include <aalwines/utils/query_budget.h>
+#include <aalwines/utils/work_stealing_pool.h>
 #include <pdaaal/PDAFactory.h>
 
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <optional>
+
 namespace aalwines {
 
+    /**
+     * The network part of the PDA made by NetworkPDAFactory::build_pda: its states and (optionally) its rules.
+     * This only depends on the path NFA, the number of failures and the weight function, and not on the header NFAs,
+     * so it can be built once and replayed for a group of queries that share these (see Query::path_signature).
+     * The NFA state pointers refer to the path NFA of the query that built it, and are only used for identity.
+     * The op suffix ids refer to the RuleTemplates it was built with, so every query sharing it must use the same templates.
+     * Rules are only added for forwarding rules with _priority <= _failures, so the construction for k+1 failures is a superset
+     * of the one for k failures. It can be extended by expanding the _deferred states and the states after _expanded,
+     * unless it is _pruned, since states that were irrelevant for k failures may be relevant for k+1.
+     */
+    template<typename W_FN = std::function<void(void)>>
+    struct NetworkPDAConstruction {
+        using label_t = Query::label_t;
+        using nfa_state_t = pdaaal::NFA<label_t>::state_t;
+        using edge_variant = typename NetworkTranslationW<W_FN>::edge_variant;
+        // The pending operations are an op suffix id of RuleTemplates, so a state is three fixed-width values.
+        using state_t = std::tuple<edge_variant, const nfa_state_t*, size_t>;
+        struct state_hash {
+            size_t operator()(const state_t& state) const {
+                const auto& [edge, nfa_state, ops] = state;
+                auto edge_pointer = edge.index() == 0 ? reinterpret_cast<uintptr_t>(std::get<0>(edge)) : reinterpret_cast<uintptr_t>(std::get<1>(edge)) + 1;
+                auto hash = utils::mix_hash(edge_pointer);
+                hash = utils::mix_hash(hash ^ reinterpret_cast<uintptr_t>(nfa_state));
+                return utils::mix_hash(hash ^ ops);
+            }
+        };
+        using weight_type = pdaaal::weight<typename W_FN::result_type>;
+        static constexpr bool is_weighted = pdaaal::is_weighted<weight_type>;
+        struct rule_t {
+            size_t _from;
+            label_t _pre;
+            size_t _to;
+            pdaaal::op_t _op;
+            label_t _op_label;
+            std::conditional_t<is_weighted, typename weight_type::type, std::tuple<>> _weight;
+            bool _wildcard;
+        };
+
+        utils::flat_id_set<state_t, state_hash> _states;
+        std::vector<size_t> _initial;
+        std::vector<size_t> _accepting;
+        std::vector<rule_t> _rules; // Only recorded when the construction is shared.
+        size_t _failures = 0; // The number of failures it was built for.
+        size_t _expanded = 0; // States before this index have been expanded.
+        std::vector<size_t> _deferred; // States with forwarding rules that need more than _failures failures.
+        bool _pruned = false; // States or rules that are not relevant for _failures (see PathReachability and LabelFlow) were left out.
+    };
+    // Slot shared by a group of queries. Empty until the first query of the group has built the construction.
+    template<typename W_FN = std::function<void(void)>>
+    using SharedNetworkPDAConstruction = std::shared_ptr<const NetworkPDAConstruction<W_FN>>;
+
     template<typename W_FN = std::function<void(void)>, typename W = pdaaal::weight<void>, pdaaal::TraceInfoType trace_info_type = pdaaal::TraceInfoType::Single>
     class NetworkPDAFactory : public pdaaal::PDAFactory<Query::label_t, W, trace_info_type> {
         using label_t = Query::label_t;
@@ -48,16 +111,53 @@ namespace aalwines {
         using trace_state_t = typename PDA::tracestate_t;
     private:
         using Translation = NetworkTranslationW<W_FN>;
-        using edge_variant = typename Translation::edge_variant;
-        using op_t = std::tuple<pdaaal::op_t,label_t>;
-        using ops_t = std::vector<op_t>;
-        using state_t = std::tuple<edge_variant, const nfa_state_t*, ops_t>;
+        using Construction = NetworkPDAConstruction<W_FN>;
+        using edge_variant = typename Construction::edge_variant;
+        using state_t = typename Construction::state_t;
     public:
-        NetworkPDAFactory(const Query& query, Network &network, Builder::labelset_t&& all_labels)
-        : NetworkPDAFactory(query, network, std::move(all_labels), [](){}) {};
+        NetworkPDAFactory(const Query& query, Network &network, const Builder::labelset_t& all_labels)
+        : NetworkPDAFactory(query, network, all_labels, [](){}) {};
+
+        // pdaaal::PDAFactory copies and rehashes all_labels, once per factory, so this copy is still paid per query.
+        // Avoiding it needs a pdaaal constructor that keeps a reference to the set, which pdaaal v1.1.0 does not have.
+        NetworkPDAFactory(const Query& query, const Network& network, const Builder::labelset_t& all_labels, const W_FN& weight_f)
+        : PDAFactory(all_labels), _translation(query, network, weight_f), _query(query), _network(network), _weight_f(weight_f) { };
+
+        // Use the (shared) rule templates of the network, e.g. Builder::rule_templates(). Otherwise they are made by build_pda.
+        void set_rule_templates(const RuleTemplates* templates) { _templates = templates; }
+        // Use the (shared) compiled network, e.g. Builder::compiled_network(). This also sets the rule templates. Otherwise it is made by build_pda.
+        void set_compiled_network(const CompiledNetwork* compiled) {
+            _compiled = compiled;
+            _templates = &compiled->templates();
+        }
 
-        NetworkPDAFactory(const Query& query, const Network& network, Builder::labelset_t&& all_labels, const W_FN& weight_f)
-        : PDAFactory(std::move(all_labels)), _translation(query, network, weight_f), _query(query), _weight_f(weight_f) { };
+        // In lazy mode, rules are only generated for the entries whose label can be on top of the stack when a state is reached.
+        // The PDA then only contains the part of the network that is reachable from the construction header.
+        // A lazy construction depends on the header, so it is never shared (see share_construction).
+        void set_lazy(bool lazy) { _lazy = lazy; }
+
+        // Leave out states whose (interface, path NFA state) pair cannot be on an accepting run, found by PathReachability before building.
+        void set_pruning(bool prune) { _prune = prune; }
+
+        // Leave out the entries whose label cannot be on top of the stack when their table is reached, found by LabelFlow before building.
+        // This depends on the header, so a sliced construction is never shared (see share_construction). Lazy mode already does this per state.
+        void set_label_slicing(bool slice) { _slice_labels = slice; }
+
+        // Number of threads used to expand the states of the PDA. The result does not depend on it.
+        // Levels of the breadth-first expansion with fewer than min_parallel_level states are expanded by the calling thread.
+        void set_threads(size_t threads, size_t min_parallel_level = 256) {
+            _threads = threads;
+            _min_parallel_level = min_parallel_level;
+        }
+
+        // Checked regularly during construction of the PDA. May be nullptr for no limits.
+        void set_budget(const utils::query_budget* budget) { _budget = budget; }
+
+        // Reuse the construction in slot if it is there, otherwise build it and store it in slot.
+        // A construction for fewer failures than the query is copied and the copy is extended, and one for more failures is replaced.
+        // Either way the slot then holds the new construction. A construction in the slot is never changed, since other queries may still read it.
+        // The slot must only be used by one factory at a time.
+        void share_construction(SharedNetworkPDAConstruction<W_FN>* slot) { _shared_slot = slot; }
 
         json get_json_trace(const std::vector<trace_state_t>& trace) {
             auto result_trace = json::array();
@@ -66,8 +166,8 @@ namespace aalwines {
             const Interface* last_inf = nullptr;
             for (size_t sno = 0; sno < trace.size(); ++sno) {
                 const auto& step = trace[sno];
-                auto [inf_table, nfa_state, ops] = _states.at(step._pdastate);
-                if (!ops.empty()) continue;
+                auto [inf_table, nfa_state, ops] = _result->_states.at(step._pdastate);
+                if (ops != RuleTemplates::empty_op_suffix()) continue;
                 if (last_inf == nullptr) { // Initial interface
                     last_inf = Translation::get_interface(inf_table);
                 }
@@ -77,15 +177,24 @@ namespace aalwines {
                 if (sno == trace.size() - 1) continue;
                 assert(!step._stack.empty()); // There should always be bottom-of-stack label.
                 auto table = Translation::get_table(inf_table);
-                auto [next_inf_table, next_nfa_state, next_ops] = _states.at(trace[sno + 1]._pdastate);
+                auto [next_inf_table, next_nfa_state, next_ops] = _result->_states.at(trace[sno + 1]._pdastate);
                 const auto& next_stack = trace[sno + 1]._stack;
-                auto next_inf = Translation::get_interface(next_inf_table, table);
+                // The next state is the target of the first PDA rule made from the forwarding rule, see target_state.
+                auto leads_to_next = [&next_inf_table = next_inf_table, next_ops = next_ops, this](const RoutingTable::forward_t& forward) {
+                    if (next_inf_table.index() == 1) {
+                        if (forward._via->match() != std::get<1>(next_inf_table)) return false;
+                    } else if (forward._via->match()->table() != std::get<0>(next_inf_table)) {
+                        return false;
+                    }
+                    return is_op_suffix(next_ops, forward);
+                };
+                const Interface* next_inf = nullptr;
                 bool found = false;
                 // Figure out which rule in the forwarding table generated this PDA rule (or rather step in PDA trace).
                 for (const RoutingTable::entry_t* entry : get_entries_matching(step._stack.front(), table)) {
                     assert(entry->_top_label == step._stack.front() || entry->ignores_label()); // matching on pre
                     for (const auto& forward : entry->_rules) {
-                        if (forward._via->match() != next_inf) continue;
+                        if (!leads_to_next(forward)) continue;
 
                         bool approximation_ok = false;
                         switch (_query.approximation()) {
@@ -117,6 +226,7 @@ namespace aalwines {
                         if (expected_next_stack_size == next_stack.size() && top_label_ok) {
                             if (!add_interfaces(disabled, active, *entry, forward)) continue;
                             _translation.add_rule_to_trace(result_trace, last_inf, *entry, forward);
+                            next_inf = forward._via->match();
                             found = true;
                             break;
                         }
@@ -133,87 +243,389 @@ namespace aalwines {
 
     protected:
         void build_pda() override {
-            _translation.make_initial_states([this](const Interface* inf, const nfa_state_t* nfa_state){
-                add_initial_state(inf, nfa_state);
+            if (_templates == nullptr) {
+                _templates = &_own_templates.emplace(_network);
+            }
+            if (_compiled == nullptr) {
+                _compiled = &_own_compiled.emplace(_network, *_templates);
+            }
+            if (_lazy) {
+                build_lazy();
+                return;
+            }
+            if (_slice_labels) {
+                _shared_slot = nullptr;
+            }
+            auto failures = _query.number_of_failures();
+            if (_shared_slot != nullptr && *_shared_slot && ((*_shared_slot)->_failures == failures || ((*_shared_slot)->_failures < failures && !(*_shared_slot)->_pruned))) {
+                // Replay the construction made for an earlier query. Other queries of the group may still read it, so it is never changed.
+                const auto& shared = *_shared_slot;
+                for (const auto& r : shared->_rules) {
+                    rule_t rule{r._from, r._pre, r._to, r._op, r._op_label};
+                    if constexpr (is_weighted) {
+                        rule._weight = r._weight;
+                    }
+                    if (r._wildcard) {
+                        this->add_wildcard_rule(rule);
+                    } else {
+                        this->add_rule(rule);
+                    }
+                }
+                if (shared->_failures == failures) {
+                    _result = shared;
+                    return;
+                }
+                // Extend a copy of it. The slot keeps the shared construction until the copy is done, so a copy interrupted by the budget is never reused.
+                _construction = std::make_shared<Construction>(*shared);
+                auto previous_failures = _construction->_failures;
+                _construction->_failures = failures;
+                _construction->_pruned = prepare_pruning(false);
+                auto deferred = std::move(_construction->_deferred);
+                _construction->_deferred.clear();
+                expansion_t expansion;
+                for (auto from_state : deferred) {
+                    utils::query_budget::check(_budget);
+                    prepare_weights(from_state);
+                    expand_state(from_state, previous_failures + 1, expansion);
+                    merge_expansion(from_state, expansion);
+                }
+            } else {
+                _construction = std::make_shared<Construction>();
+                _construction->_failures = failures;
+                _construction->_pruned = prepare_pruning(_slice_labels);
+                _translation.make_initial_states([this](const Interface* inf, const nfa_state_t* nfa_state){
+                    if (relevant(inf, nfa_state)) add_initial_state(inf, nfa_state);
+                });
+            }
+            // Expand the states level by level. The states of a level are expanded (possibly concurrently) without changing the construction,
+            // and then merged in order of their ids, so state ids and rules are the same as when each state is merged right after expanding it.
+            std::optional<utils::work_stealing_pool> pool;
+            expansion_t expansion;
+            for (size_t level_begin = _construction->_expanded; level_begin < _construction->_states.size(); ) {
+                auto level_end = _construction->_states.size();
+                if (_threads > 1 && level_end - level_begin >= _min_parallel_level) {
+                    if (!pool) pool.emplace(_threads);
+                    expand_level_parallel(*pool, level_begin, level_end);
+                } else {
+                    for (auto from_state = level_begin; from_state < level_end; ++from_state) {
+                        utils::query_budget::check(_budget);
+                        prepare_weights(from_state);
+                        expand_state(from_state, 0, expansion);
+                        merge_expansion(from_state, expansion);
+                    }
+                }
+                level_begin = level_end;
+            }
+            _construction->_expanded = _construction->_states.size();
+            assert(std::is_sorted(_construction->_initial.begin(), _construction->_initial.end()));
+            assert(std::is_sorted(_construction->_accepting.begin(), _construction->_accepting.end()));
+            _result = _construction;
+            if (_shared_slot != nullptr) {
+                *_shared_slot = _construction;
+            }
+        }
+
+        const std::vector<size_t>& initial() override { return _result->_initial; }
+        const std::vector<size_t>& accepting() override { return _result->_accepting; }
+
+    private:
+        void emit_rule(const rule_t& rule) {
+            record_rule(rule, false);
+            this->add_rule(rule);
+        }
+        void emit_wildcard_rule(const rule_t& rule) {
+            record_rule(rule, true);
+            this->add_wildcard_rule(rule);
+        }
+        void record_rule(const rule_t& rule, bool wildcard) {
+            if (_shared_slot == nullptr) return;
+            typename Construction::rule_t r{rule._from, rule._pre, rule._to, rule._op, rule._op_label, {}, wildcard};
+            if constexpr (is_weighted) {
+                r._weight = rule._weight;
+            }
+            _construction->_rules.push_back(r);
+        }
+
+        // The rules made by expanding one state. Targets are kept as states, since they only get ids when the expansion is merged.
+        struct expansion_t {
+            std::vector<std::tuple<rule_t,state_t,bool>> _rules; // Rule (except _to), target state, and whether it is a wildcard rule.
+            bool _deferred = false;
+            void clear() {
+                _rules.clear();
+                _deferred = false;
+            }
+        };
+        // Expand from_state into expansion. For tables, only forwarding rules with min_priority <= _priority <= number of failures are used.
+        // This only reads the construction (and the weights, see prepare_weights), so expansions of different states can run concurrently.
+        void expand_state(size_t from_state, size_t min_priority, expansion_t& expansion) const {
+            expansion.clear();
+            const auto& [variant, nfa_state, ops] = _construction->_states.at(from_state);
+            if (variant.index() == 1) { // Interface pointer. Make no-op rule to corresponding table.
+                expansion._rules.emplace_back(rule_t{from_state, Query::wildcard_label(), 0, pdaaal::NOOP, Query::label_t()},
+                                              state_t{std::get<1>(variant)->table(), nfa_state, ops}, true);
+            } else if (ops != RuleTemplates::empty_op_suffix()) {
+                const auto& first_op = _templates->op_suffix_head(ops);
+                expansion._rules.emplace_back(rule_t{from_state, Query::wildcard_label(), 0, std::get<0>(first_op), std::get<1>(first_op)},
+                                              state_t{variant, nfa_state, _templates->op_suffix_tail(ops)}, true);
+            } else {
+                const auto& index = _query.path_index();
+                auto row = index.row(nfa_state);
+                auto table = _templates->table(std::get<0>(variant));
+                for (const auto& forward : table) {
+                    if (forward._priority < min_priority) continue;
+                    if (forward._priority > _query.number_of_failures()) {
+                        expansion._deferred = true;
+                        continue;
+                    }
+                    if (_label_flow && forward._pre != Query::wildcard_label() && !_label_flow->may_reach(table._table_id, forward._pre)) continue;
+                    rule_t rule;
+                    rule._from = from_state;
+                    rule._pre = forward._pre;
+                    rule._op = forward._op;
+                    rule._op_label = forward._op_label;
+                    auto rule_index = _templates->index(forward);
+                    if constexpr (is_weighted) {
+                        rule._weight = _weights[rule_index];
+                    }
+                    for (const auto& n : index.successors(row, forward._via_id)) { // Follow NFA edges matching forward._via
+                        if (!relevant(_compiled->rule_target(rule_index), n)) continue;
+                        expansion._rules.emplace_back(rule, target_state(rule_index, n, forward._op_suffix),
+                                                      rule._pre == Query::wildcard_label());
+                    }
+                }
+            }
+        }
+        void merge_expansion(size_t from_state, const expansion_t& expansion) {
+            for (auto [rule, target, wildcard] : expansion._rules) {
+                rule._to = add_state(target);
+                if (wildcard) {
+                    emit_wildcard_rule(rule);
+                } else {
+                    emit_rule(rule);
+                }
+            }
+            if (expansion._deferred) {
+                _construction->_deferred.push_back(from_state);
+            }
+        }
+        void prepare_weights(size_t from_state) {
+            if constexpr (is_weighted) {
+                const auto& [variant, nfa_state, ops] = _construction->_states.at(from_state);
+                if (variant.index() == 0 && ops == RuleTemplates::empty_op_suffix()) {
+                    compute_weights(_templates->table(std::get<0>(variant)));
+                }
+            }
+        }
+        // Expand the states in [begin, end) on the pool in chunks, and merge them in order afterwards.
+        void expand_level_parallel(utils::work_stealing_pool& pool, size_t begin, size_t end) {
+            for (auto from_state = begin; from_state < end; ++from_state) {
+                prepare_weights(from_state);
+            }
+            std::vector<expansion_t> expansions(end - begin);
+            auto chunk_size = std::max<size_t>((end - begin) / (pool.size() * 4), 64);
+            auto chunks = (end - begin + chunk_size - 1) / chunk_size;
+            std::vector<std::exception_ptr> errors(chunks);
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                pool.submit([&, chunk](){
+                    try {
+                        auto chunk_end = std::min(end, begin + (chunk + 1) * chunk_size);
+                        for (auto from_state = begin + chunk * chunk_size; from_state < chunk_end; ++from_state) {
+                            utils::query_budget::check(_budget);
+                            expand_state(from_state, 0, expansions[from_state - begin]);
+                        }
+                    } catch (...) {
+                        errors[chunk] = std::current_exception();
+                    }
+                });
+            }
+            pool.wait();
+            for (const auto& error : errors) {
+                if (error) std::rethrow_exception(error);
+            }
+            for (auto from_state = begin; from_state < end; ++from_state) {
+                merge_expansion(from_state, expansions[from_state - begin]);
+            }
+        }
+
+        // Worklist over states: a state is (re-)expanded when it is first reached and whenever new top labels reach it.
+        // Rules for an entry are added once its label is among the top labels, and wildcard rules are added on the first visit.
+        void build_lazy() {
+            _construction = std::make_shared<Construction>();
+            _construction->_failures = _query.number_of_failures();
+            _construction->_pruned = prepare_pruning(false);
+            using labels_t = LabelFlow::labels_t;
+            const auto header = LabelFlow::header_labels(*_templates, _query.construction());
+            const auto& stack_labels = header.first; // Not a structured binding, since the lambdas below use these.
+            const auto& initial_labels = header.second;
+            std::vector<labels_t> tops;  // Labels that have reached the state.
+            std::vector<labels_t> done;  // Labels for which the state has been expanded.
+            std::vector<bool> visited, queued;
+            std::vector<size_t> worklist;
+            auto reach = [&](size_t state, const labels_t& labels) {
+                if (state >= tops.size()) {
+                    tops.resize(state + 1);
+                    done.resize(state + 1);
+                    visited.resize(state + 1, false);
+                    queued.resize(state + 1, false);
+                }
+                if (tops[state].merge(labels) && !queued[state]) {
+                    queued[state] = true;
+                    worklist.push_back(state);
+                }
+            };
+            _translation.make_initial_states([&](const Interface* inf, const nfa_state_t* nfa_state){
+                if (relevant(inf, nfa_state)) reach(add_initial_state(inf, nfa_state), initial_labels);
             });
-            for (size_t from_state = 0; from_state < _states.size(); ++from_state) {
-                auto [variant, nfa_state, ops] = _states.at(from_state);
+            while (!worklist.empty()) {
+                utils::query_budget::check(_budget);
+                auto from_state = worklist.back();
+                worklist.pop_back();
+                queued[from_state] = false;
+                auto current = tops[from_state];
+                bool first = !visited[from_state];
+                visited[from_state] = true;
+                auto [variant, nfa_state, ops] = _construction->_states.at(from_state);
                 if (variant.index() == 1) { // Interface pointer. Make no-op rule to corresponding table.
                     auto to_state = add_state({std::get<1>(variant)->table(), nfa_state, ops});
-                    rule_t rule{from_state, Query::wildcard_label(), to_state, pdaaal::NOOP, Query::label_t()};
-                    this->add_wildcard_rule(rule);
+                    if (first) {
+                        emit_wildcard_rule(rule_t{from_state, Query::wildcard_label(), to_state, pdaaal::NOOP, Query::label_t()});
+                    }
+                    reach(to_state, current);
+                } else if (ops != RuleTemplates::empty_op_suffix()) {
+                    auto [op, op_label] = _templates->op_suffix_head(ops);
+                    auto to_state = add_state({variant, nfa_state, _templates->op_suffix_tail(ops)});
+                    if (first) {
+                        emit_wildcard_rule(rule_t{from_state, Query::wildcard_label(), to_state, op, op_label});
+                    }
+                    reach(to_state, LabelFlow::after(op, op_label, current, stack_labels));
                 } else {
-                    if (ops.empty()) {
-                        assert(variant.index() == 0);
-                        const auto& table = std::get<0>(variant);
-                        for (const auto& entry : table->entries()) {
-                            for (const auto& forward : entry._rules) {
-                                if (forward._priority > _query.number_of_failures()) continue;
-                                auto first_op = forward.first_action();
-                                ops_t other_ops;
-                                if (!forward._ops.empty()) {
-                                    for (auto action_it = forward._ops.begin() + 1; action_it != forward._ops.end(); ++action_it) {
-                                        other_ops.emplace_back(action_it->convert_to_pda_op());
-                                    }
-                                }
-                                rule_t rule;
-                                rule._from = from_state;
-                                rule._pre = entry._top_label;
-                                rule._op = std::get<0>(first_op);
-                                rule._op_label = std::get<1>(first_op);
-                                if constexpr (is_weighted) {
-                                    rule._weight = _weight_f(forward, entry);
-                                }
-                                for (const auto& e : nfa_state->_edges) { // Follow NFA edges matching forward._via
-                                    if (!e.contains(forward._via->global_id())) continue;
-                                    for (const auto& n : e.follow_epsilon()) {
-                                        rule._to = add_state(forward._via->match(), n, other_ops);
-                                        if (rule._pre == Query::wildcard_label()) {
-                                            this->add_wildcard_rule(rule);
-                                        } else {
-                                            this->add_rule(rule);
-                                        }
-                                    }
+                    auto table = _templates->table(std::get<0>(variant));
+                    if constexpr (is_weighted) {
+                        compute_weights(table);
+                    }
+                    auto row = _query.path_index().row(nfa_state);
+                    for (const auto& forward : table) {
+                        if (forward._priority > _query.number_of_failures()) continue;
+                        bool wildcard = forward._pre == Query::wildcard_label();
+                        bool emit;
+                        labels_t next;
+                        if (wildcard) {
+                            emit = first;
+                            next = LabelFlow::after(forward._op, forward._op_label, current, stack_labels);
+                        } else {
+                            if (!current.contains(forward._pre, stack_labels) || done[from_state].contains(forward._pre, stack_labels)) continue;
+                            emit = true;
+                            next = LabelFlow::after(forward._op, forward._op_label, labels_t{false, false, {forward._pre}}, stack_labels);
+                        }
+                        rule_t rule;
+                        rule._from = from_state;
+                        rule._pre = forward._pre;
+                        rule._op = forward._op;
+                        rule._op_label = forward._op_label;
+                        auto rule_index = _templates->index(forward);
+                        if constexpr (is_weighted) {
+                            rule._weight = _weights[rule_index];
+                        }
+                        for (const auto& n : _query.path_index().successors(row, forward._via_id)) { // Follow NFA edges matching forward._via
+                            if (!relevant(_compiled->rule_target(rule_index), n)) continue;
+                            rule._to = add_state(target_state(rule_index, n, forward._op_suffix));
+                            if (emit) {
+                                if (wildcard) {
+                                    emit_wildcard_rule(rule);
+                                } else {
+                                    emit_rule(rule);
                                 }
                             }
+                            reach(rule._to, next);
                         }
-                    } else {
-                        auto first_op = ops[0];
-                        auto to_state = add_state({variant, nfa_state, ops_t(ops.begin()+1, ops.end())});
-                        this->add_wildcard_rule(rule_t{from_state, Query::wildcard_label(), to_state, std::get<0>(first_op), std::get<1>(first_op)});
                     }
                 }
+                done[from_state] = current;
             }
-            assert(std::is_sorted(_initial.begin(), _initial.end()));
-            assert(std::is_sorted(_accepting.begin(), _accepting.end()));
+            _construction->_expanded = _construction->_states.size();
+            assert(std::is_sorted(_construction->_initial.begin(), _construction->_initial.end()));
+            assert(std::is_sorted(_construction->_accepting.begin(), _construction->_accepting.end()));
+            _result = _construction;
         }
 
-        const std::vector<size_t>& initial() override { return _initial; }
-        const std::vector<size_t>& accepting() override { return _accepting; }
+        // Run the pre-analyses used to leave out states and rules. Returns whether the construction is pruned.
+        bool prepare_pruning(bool slice_labels) {
+            _reachability.reset();
+            _label_flow.reset();
+            if (!_prune && !slice_labels) return false;
+            PathReachability::pairs_t initial;
+            _translation.make_initial_states([&initial](const Interface* inf, const nfa_state_t* nfa_state){
+                initial.emplace_back(inf, nfa_state);
+            });
+            if (_prune) {
+                _reachability.emplace(_network, _query.path_index(), *_templates, _query.number_of_failures(), initial, _budget);
+            }
+            if (slice_labels) {
+                std::vector<const Interface*> initial_interfaces;
+                initial_interfaces.reserve(initial.size());
+                for (const auto& [inf, nfa_state] : initial) initial_interfaces.push_back(inf);
+                _label_flow.emplace(*_templates, _query.construction(), initial_interfaces, _query.number_of_failures(), _budget);
+            }
+            return true;
+        }
+        [[nodiscard]] bool relevant(const Interface* inf, const nfa_state_t* nfa_state) const {
+            return !_reachability || _reachability->relevant(inf, nfa_state);
+        }
+        [[nodiscard]] bool relevant(size_t inf_id, const nfa_state_t* nfa_state) const {
+            return !_reachability || _reachability->relevant(inf_id, nfa_state);
+        }
+
+        // The weight function is evaluated once per forwarding rule of the tables that are reached.
+        void compute_weights(const RuleTemplates::range_t& table) {
+            if (_weights.empty()) {
+                _weights.resize(_templates->size());
+                _weights_ready.resize(_templates->number_of_tables(), false);
+            }
+            if (_weights_ready[table._table_id]) return;
+            for (const auto& forward : table) {
+                _weights[_templates->index(forward)] = _weight_f(*forward._forward, *forward._entry);
+            }
+            _weights_ready[table._table_id] = true;
+        }
 
-    private:
         // Construction (factory)
         size_t add_initial_state(const Interface* inf, const nfa_state_t* nfa_state) {
-            return add_state<true>(state_t(Translation::template get_edge_pointer<true>(inf), nfa_state, ops_t()));
+            return add_state<true>(state_t(Translation::template get_edge_pointer<true>(inf), nfa_state, RuleTemplates::empty_op_suffix()));
+        }
+        size_t add_state(const Interface* inf, const nfa_state_t* nfa_state, size_t ops) {
+            return add_state(target_state(inf, nfa_state, ops));
+        }
+        // The state reached by a forwarding rule to inf with remaining operations ops.
+        // The intermediate states of an op chain are keyed by the table of inf instead of the edge, so a chain is shared
+        // by all edges into that table, and it ends directly in the table state. The trace finds the edge from the forwarding rule.
+        static state_t target_state(const Interface* inf, const nfa_state_t* nfa_state, size_t ops) {
+            if (ops == RuleTemplates::empty_op_suffix()) {
+                return {Translation::get_edge_pointer(inf), nfa_state, ops};
+            }
+            return {inf->table(), nfa_state, ops};
         }
-        size_t add_state(const Interface* inf, const nfa_state_t* nfa_state, const ops_t& ops) {
-            return add_state({Translation::get_edge_pointer(inf), nfa_state, ops});
+        // Same as above for the interface that forwarding rule (template index) rule leads to, read from the compiled network.
+        state_t target_state(size_t rule, const nfa_state_t* nfa_state, size_t ops) const {
+            if (ops == RuleTemplates::empty_op_suffix()) {
+                return {_compiled->rule_target_edge(rule), nfa_state, ops};
+            }
+            return {_compiled->table(_compiled->rule_target_table(rule)), nfa_state, ops};
         }
         template<bool initial = false>
         size_t add_state(const state_t& state) {
-            auto res = _states.insert(state);
+            auto res = _construction->_states.insert(state);
             if (res.first) {
                 if (accepting(state)) {
-                    _accepting.push_back(res.second);
+                    _construction->_accepting.push_back(res.second);
                 }
                 if constexpr (initial) {
-                    _initial.push_back(res.second);
+                    _construction->_initial.push_back(res.second);
                 }
             }
             return res.second;
         }
         static bool accepting(const state_t& state) {
-            return std::get<1>(state)->_accepting && std::get<2>(state).empty() && std::get<0>(state).index() == 0;
+            return std::get<1>(state)->_accepting && std::get<2>(state) == RuleTemplates::empty_op_suffix() && std::get<0>(state).index() == 0;
         }
 
         // Trace reconstruction
@@ -247,6 +659,14 @@ namespace aalwines {
             }
         }
 
+        // Whether ops is the op suffix of forward, i.e. its operations after the first.
+        bool is_op_suffix(size_t ops, const RoutingTable::forward_t& forward) const {
+            for (size_t i = 1; i < forward._ops.size(); ++i, ops = _templates->op_suffix_tail(ops)) {
+                if (ops == RuleTemplates::empty_op_suffix() || RuleTemplates::op_t(forward._ops[i].convert_to_pda_op()) != _templates->op_suffix_head(ops)) return false;
+            }
+            return ops == RuleTemplates::empty_op_suffix();
+        }
+
         auto get_entries_matching(const label_t& label, const RoutingTable* table) const {
             assert(std::is_sorted(table->entries().begin(), table->entries().end()));
             std::vector<const RoutingTable::entry_t*> matching_entries;
@@ -262,19 +682,34 @@ namespace aalwines {
 
         Translation _translation;
         const Query& _query;
-        pdaaal::utils::ptrie_set<state_t> _states;
-        std::vector<size_t> _initial;
-        std::vector<size_t> _accepting;
+        const Network& _network;
+        bool _lazy = false;
+        bool _prune = false;
+        bool _slice_labels = false;
+        size_t _threads = 1;
+        size_t _min_parallel_level = 256;
+        const RuleTemplates* _templates = nullptr;
+        std::optional<RuleTemplates> _own_templates;
+        const CompiledNetwork* _compiled = nullptr;
+        std::optional<CompiledNetwork> _own_compiled;
+        std::conditional_t<is_weighted, std::vector<typename weight_type::type>, std::tuple<>> _weights;
+        std::vector<bool> _weights_ready; // Per table id
+        std::shared_ptr<Construction> _construction; // Built (or extended) by this factory.
+        std::shared_ptr<const Construction> _result; // The construction of the PDA: _construction, or a shared one that is only replayed.
+        std::optional<PathReachability> _reachability;
+        std::optional<LabelFlow> _label_flow;
+        SharedNetworkPDAConstruction<W_FN>* _shared_slot = nullptr;
         const W_FN& _weight_f;
+        const utils::query_budget* _budget = nullptr;
     };
 
     template<typename W_FN>
-    NetworkPDAFactory(Query& query, Network& network, Builder::labelset_t&& all_labels, const W_FN& weight_f) -> NetworkPDAFactory<W_FN, pdaaal::weight<typename W_FN::result_type>>;
+    NetworkPDAFactory(Query& query, Network& network, const Builder::labelset_t& all_labels, const W_FN& weight_f) -> NetworkPDAFactory<W_FN, pdaaal::weight<typename W_FN::result_type>>;
 
     // Add make function that allows specifying template parameter trace_info_type.
     template<pdaaal::TraceInfoType trace_info_type, typename W_FN>
-    auto makeNetworkPDAFactory(Query& query, Network& network, Builder::labelset_t&& all_labels, const W_FN& weight_f) {
-        return NetworkPDAFactory<W_FN, pdaaal::weight<typename W_FN::result_type>,trace_info_type>(query, network, std::move(all_labels), weight_f);
+    auto makeNetworkPDAFactory(Query& query, Network& network, const Builder::labelset_t& all_labels, const W_FN& weight_f) {
+        return NetworkPDAFactory<W_FN, pdaaal::weight<typename W_FN::result_type>,trace_info_type>(query, network, all_labels, weight_f);
     }
 
 }
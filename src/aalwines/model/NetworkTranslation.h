@@ -51,25 +51,18 @@ namespace aalwines {
             make_initial_states(add_many);
         }
         void make_initial_states(const std::function<void(const Interface*, const std::vector<nfa_state_t*>&)>& add) {
+            const auto& index = _query.path_index();
             for (const auto& i : _query.path().initial()) {
-                for (const auto& e : i->_edges) {
-                    auto next = e.follow_epsilon();
-                    if (e.wildcard(_network.all_interfaces().size())) {
-                        for (const auto& inf : _network.all_interfaces()) {
-                            add(inf->match(), next);
-                        }
-                    } else if (!e._negated) {
-                        for (const auto& s : e._symbols) {
-                            auto inf = _network.all_interfaces()[s];
-                            add(inf->match(), next);
-                        }
-                    } else {
-                        for (const auto& inf : _network.all_interfaces()) {
-                            if (e.contains(inf->global_id())) {
-                                add(inf->match(), next);
-                            }
-                        }
+                auto row = index.row(i);
+                if (index.has_default(row)) {
+                    for (const auto& inf : _network.all_interfaces()) {
+                        const auto& next = index.successors(row, inf->global_id());
+                        if (!next.empty()) add(inf->match(), next);
                     }
+                } else {
+                    index.for_each_mentioned(row, [&](size_t id, const std::vector<nfa_state_t*>& next) {
+                        if (!next.empty()) add(_network.all_interfaces()[id]->match(), next);
+                    });
                 }
             }
         }
@@ -85,20 +78,33 @@ namespace aalwines {
                     return interface;
                 }
             } else {
-                auto out_infs = utils::flat_union_if(interface->target()->tables(),
-                    [](const auto& table){ return table->out_interfaces(); },
-                    [match=interface->match()](const auto& table){ return utils::sorted_contains(table->out_interfaces(), match); }
-                );
-                auto intersection = interface_intersection(out_infs, interface->table());
-                if (intersection.size() == 1) {
-                    assert(intersection[0] == interface);
-                    return interface->table(); // interface is uniquely identified by interface->table() and any table t with interface->match() in t->out_interfaces() (t being part of previous state in PDA.)
-                } else {
-                    assert(intersection.size() > 1);
-                    return interface; // Multiple edges (inf,inf->match()) pairs correspond to the same pair of tables, so we need interface to identify edge.
+                switch (interface->edge_identification()) { // Precomputed by Network::identify_edges()
+                    case Interface::edge_identification_t::TABLE:
+                        assert(identify_edge(interface) == edge_variant(interface->table()));
+                        return interface->table();
+                    case Interface::edge_identification_t::INTERFACE:
+                        assert(identify_edge(interface) == edge_variant(interface));
+                        return interface;
+                    default:
+                        return identify_edge(interface);
                 }
             }
         }
+        // The uncached computation behind Interface::edge_identification().
+        static edge_variant identify_edge(const Interface* interface) {
+            auto out_infs = utils::flat_union_if(interface->target()->tables(),
+                [](const auto& table){ return table->out_interfaces(); },
+                [match=interface->match()](const auto& table){ return utils::sorted_contains(table->out_interfaces(), match); }
+            );
+            auto intersection = interface_intersection(out_infs, interface->table());
+            if (intersection.size() == 1) {
+                assert(intersection[0] == interface);
+                return interface->table(); // interface is uniquely identified by interface->table() and any table t with interface->match() in t->out_interfaces() (t being part of previous state in PDA.)
+            } else {
+                assert(intersection.size() > 1);
+                return interface; // Multiple edges (inf,inf->match()) pairs correspond to the same pair of tables, so we need interface to identify edge.
+            }
+        }
         static std::vector<const Interface*> interface_intersection(const RoutingTable* from, const RoutingTable* to) {
             assert(from != nullptr);
             return interface_intersection(from->out_interfaces(), to);
@@ -139,9 +145,13 @@ namespace aalwines {
                 assert(to->interfaces().size() == 1);
                 return to->interfaces()[0];
             } else {
-                auto intersection = interface_intersection(from, to);
-                assert(intersection.size() == 1);
-                return intersection[0];
+                assert(interface_intersection(from, to).size() == 1);
+                // Same as the only element of interface_intersection(from, to), but without allocating.
+                for (const auto* inf : to->interfaces()) {
+                    if (utils::sorted_contains(from->out_interfaces(), inf->match())) return inf;
+                }
+                assert(false);
+                return nullptr;
             }
         }
 
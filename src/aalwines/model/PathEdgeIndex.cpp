@@ -0,0 +1,63 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   PathEdgeIndex.cpp
+ *
+ * Created on 17-10-2026.
+ */
+
+#include "PathEdgeIndex.h"
+
+#include <algorithm>
+
+namespace aalwines {
+
+    PathEdgeIndex::PathEdgeIndex(const NFA& nfa) {
+        for (const auto& state : nfa.states()) {
+            std::vector<size_t> mentioned;
+            successors_t default_successors;
+            for (const auto& e : state->_edges) {
+                mentioned.insert(mentioned.end(), e._symbols.begin(), e._symbols.end());
+                if (e._negated) {
+                    auto next = e.follow_epsilon();
+                    default_successors.insert(default_successors.end(), next.begin(), next.end());
+                }
+            }
+            std::sort(mentioned.begin(), mentioned.end());
+            mentioned.erase(std::unique(mentioned.begin(), mentioned.end()), mentioned.end());
+
+            row_t row{state.get(), _ids.size(), _ids.size() + mentioned.size(), 0};
+            for (auto id : mentioned) {
+                successors_t successors;
+                for (const auto& e : state->_edges) {
+                    if (!e.contains(id)) continue;
+                    auto next = e.follow_epsilon();
+                    successors.insert(successors.end(), next.begin(), next.end());
+                }
+                _ids.push_back(id);
+                _successors.push_back(std::move(successors));
+            }
+            // Keep _ids and _successors aligned, so the default successors get an id slot that is never searched.
+            row._default = _successors.size();
+            _ids.push_back(0);
+            _successors.push_back(std::move(default_successors));
+
+            _rows.emplace(state.get(), _row_data.size());
+            _row_data.push_back(row);
+        }
+    }
+
+}
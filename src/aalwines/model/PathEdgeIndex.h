@@ -0,0 +1,93 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   PathEdgeIndex.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_PATHEDGEINDEX_H
+#define AALWINES_PATHEDGEINDEX_H
+
+#include <pdaaal/NFA.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace aalwines {
+
+    /**
+     * Index of the edges of a (compiled) path NFA by interface global id: for each state and interface, the successor states
+     * after following the edges that contain the interface (and epsilon edges), in the same order as iterating the edges.
+     * Interfaces that are mentioned by an edge of the state are kept in a sorted array, and all other interfaces share
+     * the default successors, which come from the negated edges (incl. wildcards).
+     * The index points into the NFA, so it must be rebuilt if the NFA is copied.
+     */
+    class PathEdgeIndex {
+    public:
+        using NFA = pdaaal::NFA<size_t>;
+        using nfa_state_t = NFA::state_t;
+        using successors_t = std::vector<nfa_state_t*>;
+
+        explicit PathEdgeIndex(const NFA& nfa);
+
+        // Index of the row for state. Look it up once, and use it for all interfaces.
+        [[nodiscard]] size_t row(const nfa_state_t* state) const { return _rows.at(state); }
+        // Rows are numbered [0, size()) in the order of nfa.states().
+        [[nodiscard]] size_t size() const { return _row_data.size(); }
+        [[nodiscard]] const nfa_state_t* state(size_t row) const { return _row_data[row]._state; }
+
+        [[nodiscard]] const successors_t& successors(size_t row, size_t interface_id) const {
+            const auto& r = _row_data[row];
+            auto begin = _ids.begin() + r._ids_begin;
+            auto end = _ids.begin() + r._ids_end;
+            auto it = std::lower_bound(begin, end, interface_id);
+            if (it != end && *it == interface_id) {
+                return _successors[it - _ids.begin()];
+            }
+            return _successors[r._default];
+        }
+
+        // Whether interfaces that are not mentioned by the edges of the row have successors.
+        [[nodiscard]] bool has_default(size_t row) const { return !_successors[_row_data[row]._default].empty(); }
+
+        // Calls fn(interface_id, successors) for the interfaces mentioned by the edges of the row, in increasing order of id.
+        template<typename FN>
+        void for_each_mentioned(size_t row, FN&& fn) const {
+            const auto& r = _row_data[row];
+            for (auto i = r._ids_begin; i < r._ids_end; ++i) {
+                fn(_ids[i], _successors[i]);
+            }
+        }
+
+    private:
+        struct row_t {
+            const nfa_state_t* _state;
+            size_t _ids_begin;
+            size_t _ids_end;
+            size_t _default; // Index into _successors
+        };
+        std::unordered_map<const nfa_state_t*, size_t> _rows;
+        std::vector<row_t> _row_data;
+        std::vector<size_t> _ids; // Mentioned interface ids of all rows. _successors[i] belongs to _ids[i].
+        std::vector<successors_t> _successors; // Also holds the default successors of each row, after the mentioned ids.
+    };
+
+}
+
+#endif //AALWINES_PATHEDGEINDEX_H
@@ -0,0 +1,113 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   PathReachability.cpp
+ *
+ * Created on 17-10-2026.
+ */
+
+#include "PathReachability.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace aalwines {
+
+    PathReachability::PathReachability(const Network& network, const PathEdgeIndex& index, const RuleTemplates& templates, size_t max_priority,
+                                       const pairs_t& initial, const utils::query_budget* budget)
+    : _index(index), _relevant(network.all_interfaces().size() * index.size(), false) {
+        const auto rows = index.size();
+        const auto& interfaces = network.all_interfaces();
+
+        // Forward search from the initial pairs. The steps between reached pairs are kept for the backward search.
+        std::vector<bool> reached(_relevant.size(), false);
+        std::vector<size_t> waiting;
+        std::vector<size_t> accepting;
+        std::vector<std::pair<size_t,size_t>> steps;
+        auto reach = [&](size_t pair) {
+            if (!reached[pair]) {
+                reached[pair] = true;
+                waiting.push_back(pair);
+            }
+        };
+        for (const auto& [inf, state] : initial) {
+            if (inf != nullptr) reach(inf->global_id() * rows + index.row(state));
+        }
+        // Outgoing interfaces of each table, without duplicates, over the rules with _priority <= max_priority.
+        std::vector<std::vector<const Interface*>> next_hops(templates.number_of_tables());
+        std::vector<bool> next_hops_ready(templates.number_of_tables(), false);
+        while (!waiting.empty()) {
+            utils::query_budget::check(budget);
+            auto from = waiting.back();
+            waiting.pop_back();
+            auto inf = interfaces[from / rows];
+            auto row = from % rows;
+            if (index.state(row)->_accepting) {
+                accepting.push_back(from);
+            }
+            if (inf->table() == nullptr) continue;
+            auto table = templates.table(inf->table());
+            auto& vias = next_hops[table._table_id];
+            if (!next_hops_ready[table._table_id]) {
+                for (const auto& forward : table) {
+                    if (forward._priority <= max_priority && forward._via != nullptr && forward._via->match() != nullptr) {
+                        vias.push_back(forward._via);
+                    }
+                }
+                std::sort(vias.begin(), vias.end());
+                vias.erase(std::unique(vias.begin(), vias.end()), vias.end());
+                next_hops_ready[table._table_id] = true;
+            }
+            for (const auto& via : vias) {
+                for (const auto& n : index.successors(row, via->global_id())) {
+                    auto to = via->match()->global_id() * rows + index.row(n);
+                    steps.emplace_back(from, to);
+                    reach(to);
+                }
+            }
+        }
+
+        // Backward search from the reached accepting pairs, over the reversed steps.
+        std::vector<size_t> predecessors_begin(_relevant.size() + 1, 0);
+        for (const auto& [from, to] : steps) {
+            ++predecessors_begin[to + 1];
+        }
+        std::partial_sum(predecessors_begin.begin(), predecessors_begin.end(), predecessors_begin.begin());
+        std::vector<size_t> predecessors(steps.size());
+        auto fill = predecessors_begin;
+        for (const auto& [from, to] : steps) {
+            predecessors[fill[to]++] = from;
+        }
+        for (auto pair : accepting) {
+            _relevant[pair] = true;
+        }
+        waiting = std::move(accepting);
+        while (!waiting.empty()) {
+            auto to = waiting.back();
+            waiting.pop_back();
+            ++_number_of_relevant;
+            for (auto i = predecessors_begin[to]; i < predecessors_begin[to + 1]; ++i) {
+                auto from = predecessors[i];
+                if (!_relevant[from]) {
+                    _relevant[from] = true;
+                    waiting.push_back(from);
+                }
+            }
+        }
+    }
+
+}
@@ -0,0 +1,69 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   PathReachability.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_PATHREACHABILITY_H
+#define AALWINES_PATHREACHABILITY_H
+
+#include <aalwines/model/Network.h>
+#include <aalwines/model/PathEdgeIndex.h>
+#include <aalwines/model/RuleTemplates.h>
+#include <aalwines/utils/query_budget.h>
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace aalwines {
+
+    /**
+     * Pre-analysis of the product of the network topology and the path NFA, ignoring labels.
+     * A pair (interface, NFA state) means that a packet arrived on the interface while the path NFA is in the state.
+     * From a pair there is a step for each forwarding rule (with _priority <= max_priority) of the table of the interface,
+     * following the NFA edges that match the outgoing interface. A pair is relevant if it is reachable from an initial pair,
+     * and an accepting NFA state is reachable from it. Since labels are ignored, every PDA state on an accepting run has a relevant pair.
+     */
+    class PathReachability {
+    public:
+        using nfa_state_t = PathEdgeIndex::nfa_state_t;
+        using pairs_t = std::vector<std::pair<const Interface*, const nfa_state_t*>>;
+
+        PathReachability(const Network& network, const PathEdgeIndex& index, const RuleTemplates& templates, size_t max_priority,
+                         const pairs_t& initial, const utils::query_budget* budget = nullptr);
+
+        [[nodiscard]] bool relevant(const Interface* inf, const nfa_state_t* state) const {
+            return inf == nullptr || _relevant[inf->global_id() * _index.size() + _index.row(state)];
+        }
+        // Same, for the interface with global id inf_id. Use std::numeric_limits<size_t>::max() for no interface.
+        [[nodiscard]] bool relevant(size_t inf_id, const nfa_state_t* state) const {
+            return inf_id == std::numeric_limits<size_t>::max() || _relevant[inf_id * _index.size() + _index.row(state)];
+        }
+        [[nodiscard]] size_t number_of_relevant() const { return _number_of_relevant; }
+
+    private:
+        const PathEdgeIndex& _index;
+        std::vector<bool> _relevant; // Indexed by interface global id * rows + row
+        size_t _number_of_relevant = 0;
+    };
+
+}
+
+#endif //AALWINES_PATHREACHABILITY_H
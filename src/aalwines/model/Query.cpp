@@ -26,6 +26,8 @@
 
 #include "Query.h"
 
+#include <sstream>
+#include <unordered_map>
 
 namespace aalwines {
 
@@ -37,4 +39,47 @@ namespace aalwines {
         out << "// PATH\n";
         _path.to_dot(out);
     }
+
+    std::string Query::path_signature() const {
+        return signature(_path);
+    }
+
+    std::string Query::header_signature() const {
+        return signature(_prestack) + " / " + signature(_poststack);
+    }
+
+    std::string Query::signature(const pdaaal::NFA<label_t>& nfa) {
+        // Number the states in the order they are discovered from the initial states,
+        // and describe each state by its accepting flag and its edges (symbols and successor numbers).
+        using nfa_state_t = pdaaal::NFA<label_t>::state_t;
+        std::unordered_map<const nfa_state_t*, size_t> ids;
+        std::vector<const nfa_state_t*> waiting;
+        auto id = [&ids, &waiting](const nfa_state_t* state) {
+            auto [it, fresh] = ids.emplace(state, ids.size());
+            if (fresh) waiting.push_back(state);
+            return it->second;
+        };
+        std::stringstream out;
+        out << "i";
+        for (const auto& s : nfa.initial()) {
+            out << " " << id(s);
+        }
+        for (size_t i = 0; i < waiting.size(); ++i) {
+            const auto* state = waiting[i];
+            out << ";" << (state->_accepting ? "a" : "") << "{";
+            for (const auto& e : state->_edges) {
+                out << (e._negated ? "!" : "") << "[";
+                for (const auto& symbol : e._symbols) {
+                    out << symbol << ",";
+                }
+                out << "]>";
+                for (const auto& n : e.follow_epsilon()) {
+                    out << id(n) << ",";
+                }
+                out << "|";
+            }
+            out << "}";
+        }
+        return out.str();
+    }
 }
\ No newline at end of file
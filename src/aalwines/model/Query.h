@@ -29,8 +29,11 @@
 #include <pdaaal/NFA.h>
 #include <pdaaal/utils/ptrie_interface.h>
 #include "aalwines/utils/errors.h"
+#include "aalwines/model/PathEdgeIndex.h"
 
+#include <cassert>
 #include <functional>
+#include <optional>
 #include <ostream>
 #include <ptrie/ptrie.h>
 
@@ -54,10 +57,27 @@ namespace aalwines {
             _prestack.concat(pdaaal::NFA<label_t>(std::unordered_set<label_t>{Query::bottom_of_stack()}));
             _poststack.concat(pdaaal::NFA<label_t>(std::unordered_set<label_t>{Query::bottom_of_stack()}));
         };
+        // The path index points into the path NFA, so a copy gets its own.
+        Query(const Query& other)
+        : _prestack(other._prestack), _poststack(other._poststack), _path(other._path), _link_failures(other._link_failures),
+          _mode(other._mode), _compiled(other._compiled) {
+            if (_compiled) _path_index.emplace(_path);
+        }
+        Query(Query&&) = default;
+        Query& operator=(const Query& other) {
+            if (this != &other) {
+                *this = Query(other);
+            }
+            return *this;
+        }
+        Query& operator=(Query&&) = default;
 
         pdaaal::NFA<label_t>& construction() {
             return _prestack;
         }
+        [[nodiscard]] const pdaaal::NFA<label_t>& construction() const {
+            return _prestack;
+        }
 
         pdaaal::NFA<label_t>& destruction() {
             return _poststack;
@@ -81,20 +101,42 @@ namespace aalwines {
         [[nodiscard]] size_t number_of_failures() const {
             return _link_failures;
         }
+        void set_number_of_failures(size_t link_failures) {
+            _link_failures = link_failures;
+        }
 
         void compile_nfas() {
+            if (_compiled) return;
             _prestack.compile();
             _poststack.compile();
             _path.compile();
+            _path_index.emplace(_path);
+            _compiled = true;
         }
 
+        // Successors in the path NFA by interface global id. Only available after compile_nfas().
+        [[nodiscard]] const PathEdgeIndex& path_index() const {
+            assert(_path_index);
+            return _path_index.value();
+        }
+
+        // Canonical description of the (compiled) path NFA, as seen by the PDA construction.
+        // Queries with the same path signature and number of failures have the same network part of the PDA.
+        [[nodiscard]] std::string path_signature() const;
+        // Canonical description of the (compiled) initial and final header NFAs.
+        [[nodiscard]] std::string header_signature() const;
+
         void print_dot(std::ostream& out);
     private:
+        static std::string signature(const pdaaal::NFA<label_t>& nfa);
+
         pdaaal::NFA<label_t> _prestack;
         pdaaal::NFA<label_t> _poststack;
         pdaaal::NFA<label_t> _path;
         size_t _link_failures = 0;
         mode_t _mode;
+        bool _compiled = false;
+        std::optional<PathEdgeIndex> _path_index;
     };
 }
 
@@ -49,6 +49,10 @@ namespace aalwines {
     class Interface {
         friend class Router;
     public:
+        // Whether the edge (match(), this) is identified by table() alone, given the table of the previous PDA state,
+        // or needs the interface itself. Set by Network::identify_edges(), and UNKNOWN until then.
+        enum class edge_identification_t : uint8_t { UNKNOWN, TABLE, INTERFACE };
+
         Interface(size_t id, size_t global_id, Router* target, Router* parent)
         : _id(id), _global_id(global_id), _target(target), _parent(parent) {};
         Interface(size_t id, size_t global_id, Router* parent)
@@ -90,6 +94,8 @@ namespace aalwines {
         [[nodiscard]] std::string get_name() const;
         void make_pairing(Interface* interface);
         [[nodiscard]] Interface* match() const { return _matching; }
+        [[nodiscard]] edge_identification_t edge_identification() const { return _edge_identification; }
+        void set_edge_identification(edge_identification_t edge_identification) { _edge_identification = edge_identification; }
     private:
         size_t _id = std::numeric_limits<size_t>::max();
         size_t _global_id = std::numeric_limits<size_t>::max();
@@ -97,6 +103,7 @@ namespace aalwines {
         Router* _parent = nullptr;
         Interface* _matching = nullptr;
         RoutingTable* _table = nullptr;
+        edge_identification_t _edge_identification = edge_identification_t::UNKNOWN;
     public:
         uint32_t weight = std::numeric_limits<uint32_t>::max();
     };
@@ -156,6 +156,9 @@ namespace aalwines {
         void set_out_interfaces(const std::unordered_set<const Interface*>& out_interfaces) {
             _out_interfaces = std::vector<const Interface*>(out_interfaces.begin(), out_interfaces.end());
         }
+        void set_out_interfaces(std::vector<const Interface*>&& out_interfaces) {
+            _out_interfaces = std::move(out_interfaces);
+        }
         [[nodiscard]] const std::vector<const Interface*>& out_interfaces() const {
             return _out_interfaces;
         }
@@ -0,0 +1,65 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   RuleTemplates.cpp
+ *
+ * Created on 17-10-2026.
+ */
+
+#include "RuleTemplates.h"
+
+#include <map>
+
+namespace aalwines {
+
+    RuleTemplates::RuleTemplates(const Network& network) {
+        std::map<std::pair<op_t,size_t>, size_t> suffix_ids;
+        _op_suffixes.push_back(op_suffix_t{op_t(), empty_op_suffix()}); // Placeholder for the empty suffix.
+
+        _table_begin.push_back(0);
+        for (const auto& r : network.routers()) {
+            for (const auto& table : r->tables()) {
+                _table_ids.emplace(table.get(), _table_begin.size() - 1);
+                for (const auto& entry : table->entries()) {
+                    for (const auto& forward : entry._rules) {
+                        auto [op, op_label] = forward.first_action();
+                        auto suffix = empty_op_suffix();
+                        for (auto action_it = forward._ops.rbegin(); forward._ops.size() > 1 && action_it + 1 != forward._ops.rend(); ++action_it) {
+                            op_t head = action_it->convert_to_pda_op();
+                            auto [it, fresh] = suffix_ids.emplace(std::make_pair(head, suffix), _op_suffixes.size());
+                            if (fresh) {
+                                _op_suffixes.push_back(op_suffix_t{head, suffix});
+                            }
+                            suffix = it->second;
+                        }
+                        _templates.push_back(rule_template_t{entry._top_label, op, op_label, suffix, forward._priority,
+                                                             forward._via, forward._via->global_id(), &entry, &forward});
+                    }
+                }
+                _table_begin.push_back(_templates.size());
+            }
+        }
+    }
+
+    RuleTemplates::ops_t RuleTemplates::op_suffix(size_t id) const {
+        ops_t ops;
+        for (; id != empty_op_suffix(); id = op_suffix_tail(id)) {
+            ops.push_back(op_suffix_head(id));
+        }
+        return ops;
+    }
+
+}
@@ -0,0 +1,102 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   RuleTemplates.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_RULETEMPLATES_H
+#define AALWINES_RULETEMPLATES_H
+
+#include <aalwines/model/Network.h>
+#include <aalwines/model/Query.h>
+
+#include <cassert>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace aalwines {
+
+    /**
+     * The forwarding rules of every routing table in a network, pre-converted to the form used by the PDA construction.
+     * Built once per network and shared (read-only) by all queries.
+     * The rules of a table are a contiguous range of templates, in the order of table->entries() and entry._rules.
+     * The operations after the first are interned as op suffixes in a trie: suffix id is its first op and the id of the
+     * remaining suffix, and id 0 is the empty suffix. So a suffix, and every tail of it, is identified by a single integer.
+     * Weights depend on the weight function, so they are not part of the templates. Use entry() and forward() to compute them.
+     */
+    class RuleTemplates {
+    public:
+        using label_t = Query::label_t;
+        using op_t = std::tuple<pdaaal::op_t,label_t>;
+        using ops_t = std::vector<op_t>;
+
+        struct rule_template_t {
+            label_t _pre;
+            pdaaal::op_t _op;
+            label_t _op_label;
+            size_t _op_suffix;
+            size_t _priority;
+            const Interface* _via;
+            size_t _via_id; // _via->global_id()
+            const RoutingTable::entry_t* _entry;
+            const RoutingTable::forward_t* _forward;
+        };
+        struct range_t {
+            size_t _table_id;
+            const rule_template_t* _begin;
+            const rule_template_t* _end;
+            [[nodiscard]] const rule_template_t* begin() const { return _begin; }
+            [[nodiscard]] const rule_template_t* end() const { return _end; }
+        };
+
+        explicit RuleTemplates(const Network& network);
+
+        // Tables get dense ids in [0, number_of_tables()) in the order of the routers and their tables.
+        [[nodiscard]] size_t number_of_tables() const { return _table_begin.size() - 1; }
+        [[nodiscard]] range_t table(const RoutingTable* table) const {
+            return this->table(_table_ids.at(table));
+        }
+        [[nodiscard]] range_t table(size_t id) const {
+            return range_t{id, _templates.data() + _table_begin[id], _templates.data() + _table_begin[id + 1]};
+        }
+        // Index of a template in [0, size()), e.g. for per-template data such as weights.
+        [[nodiscard]] size_t index(const rule_template_t& rule) const { return &rule - _templates.data(); }
+        [[nodiscard]] size_t size() const { return _templates.size(); }
+        [[nodiscard]] const std::vector<rule_template_t>& templates() const { return _templates; }
+
+        static constexpr size_t empty_op_suffix() noexcept { return 0; }
+        [[nodiscard]] const op_t& op_suffix_head(size_t id) const { assert(id != empty_op_suffix()); return _op_suffixes[id]._head; }
+        [[nodiscard]] size_t op_suffix_tail(size_t id) const { assert(id != empty_op_suffix()); return _op_suffixes[id]._tail; }
+        [[nodiscard]] size_t number_of_op_suffixes() const { return _op_suffixes.size(); }
+        [[nodiscard]] ops_t op_suffix(size_t id) const;
+
+    private:
+        std::vector<rule_template_t> _templates;
+        std::vector<size_t> _table_begin; // Templates of table id are in [_table_begin[id], _table_begin[id+1])
+        std::unordered_map<const RoutingTable*, size_t> _table_ids;
+        struct op_suffix_t {
+            op_t _head;
+            size_t _tail;
+        };
+        std::vector<op_suffix_t> _op_suffixes;
+    };
+
+}
+
+#endif //AALWINES_RULETEMPLATES_H
@@ -29,6 +29,8 @@
 #include <aalwines/model/builders/AalWiNesBuilder.h>
 #include <aalwines/model/builders/TopologyBuilder.h>
 #include <aalwines/model/builders/NetworkSAXHandler.h>
+#include <aalwines/model/builders/NetworkSnapshot.h>
+#include <aalwines/utils/errors.h>
 #include <iostream>
 
 namespace aalwines {
@@ -39,6 +41,23 @@ namespace aalwines {
             std::cerr << "--input cannot be used with --gml." << std::endl;
             exit(-1);
         }
+        if(!snapshot_file.empty()) {
+            if(!json_file.empty() || !topo_zoo.empty()) {
+                std::cerr << "--snapshot cannot be used with --input or --gml." << std::endl;
+                exit(-1);
+            }
+            // The snapshot is written after pre-processing, so the network is ready as loaded.
+            parsing_stopwatch.start();
+            try {
+                auto network = NetworkSnapshot::load(snapshot_file);
+                parsing_stopwatch.stop();
+                assert(network.check_sanity());
+                return network;
+            } catch (const base_error& e) {
+                std::cerr << e.what() << std::endl;
+                exit(-1);
+            }
+        }
 
         std::stringstream dummy;
         std::ostream& warnings = no_warnings ? dummy : std::cerr;
@@ -54,7 +73,9 @@ namespace aalwines {
         parsing_stopwatch.stop();
 
         assert(network.check_sanity());
+        pre_processing_stopwatch.start();
         network.pre_process(std::clog);
+        pre_processing_stopwatch.stop();
         return network;
     }
 
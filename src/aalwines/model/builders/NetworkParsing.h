@@ -46,18 +46,22 @@ namespace aalwines {
                 ("input", po::value<std::string>(&json_file), "An json-file defining the network in the AalWiNes MPLS Network format. To read from std input specify '--input -'.")
                 ("msgpack", po::bool_switch(&msgpack), "Use the binary MessagePack input format")
                 ("gml", po::value<std::string>(&topo_zoo),"A gml-file defining the topology in the format from topology zoo")
+                ("snapshot", po::value<std::string>(&snapshot_file), "A binary network snapshot written by --write-snapshot. Loads the pre-processed network without parsing or pre-processing.")
                 ;
         }
 
         [[nodiscard]] const po::options_description& options() const { return input; }
         [[nodiscard]] double duration() const { return parsing_stopwatch.duration(); }
+        // Time spent in Network::pre_process(). Zero for --snapshot, whose network is stored pre-processed.
+        [[nodiscard]] double pre_processing_duration() const { return pre_processing_stopwatch.duration(); }
         Network parse(bool no_warnings = false);
 
     private:
-        std::string json_file, topo_zoo;
+        std::string json_file, topo_zoo, snapshot_file;
         bool msgpack = false;
         po::options_description input;
         stopwatch parsing_stopwatch{false};
+        stopwatch pre_processing_stopwatch{false};
     };
 }
 
@@ -0,0 +1,358 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * File:   NetworkSnapshot.cpp
+ *
+ * Created on 17-10-2026.
+ */
+
+#include "NetworkSnapshot.h"
+
+#include <aalwines/utils/errors.h>
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace aalwines {
+
+    namespace {
+        constexpr uint32_t byte_order_mark = 0x01020304;
+        constexpr uint64_t none = std::numeric_limits<uint64_t>::max();
+        constexpr size_t word_size = sizeof(uint64_t);
+
+        struct header_t {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;
+            uint64_t payload_words;
+            uint64_t checksum;
+        };
+        static_assert(sizeof(header_t) == 32);
+
+        // FNV-1a over whole words, so verifying a large snapshot stays cheap.
+        uint64_t checksum(const char* data, size_t words) {
+            uint64_t hash = 14695981039346656037ULL;
+            for (size_t i = 0; i < words; ++i) {
+                uint64_t word;
+                std::memcpy(&word, data + i * word_size, word_size);
+                hash ^= word;
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        class snapshot_writer {
+        public:
+            void word(uint64_t value) { _words.push_back(value); }
+            void real(double value) {
+                uint64_t word;
+                std::memcpy(&word, &value, word_size);
+                _words.push_back(word);
+            }
+            void string(const std::string& value) {
+                word(value.size());
+                auto begin = _words.size();
+                _words.resize(begin + (value.size() + word_size - 1) / word_size, 0);
+                std::memcpy(_words.data() + begin, value.data(), value.size());
+            }
+            [[nodiscard]] const std::vector<uint64_t>& words() const { return _words; }
+        private:
+            std::vector<uint64_t> _words;
+        };
+
+        class snapshot_reader {
+        public:
+            snapshot_reader(const char* data, size_t words) : _data(data), _words(words) { }
+
+            uint64_t word() {
+                if (_next == _words) throw base_error("error: Network snapshot is truncated.");
+                uint64_t value;
+                std::memcpy(&value, _data + _next++ * word_size, word_size);
+                return value;
+            }
+            // Every counted element takes at least one word, so larger counts can only come from a corrupt payload.
+            size_t count() {
+                auto value = word();
+                if (value > _words - _next) throw base_error("error: Network snapshot is truncated.");
+                return value;
+            }
+            double real() {
+                auto value = word();
+                double result;
+                std::memcpy(&result, &value, word_size);
+                return result;
+            }
+            std::string string() {
+                auto size = word();
+                auto words = (size + word_size - 1) / word_size;
+                if (size > (_words - _next) * word_size) throw base_error("error: Network snapshot is truncated.");
+                std::string result(_data + _next * word_size, size);
+                _next += words;
+                return result;
+            }
+            [[nodiscard]] bool done() const { return _next == _words; }
+        private:
+            const char* _data;
+            size_t _words;
+            size_t _next = 0;
+        };
+    }
+
+    void NetworkSnapshot::write(const Network& network, std::ostream& out) {
+        snapshot_writer payload;
+        payload.string(network.name);
+        payload.word(network.routers().size());
+        payload.word(network.all_interfaces().size());
+        // Routers and interfaces come first, so the tables can refer to interfaces of any router.
+        for (const auto& router : network.routers()) {
+            payload.word(router->names().size());
+            for (const auto& name : router->names()) {
+                payload.string(name);
+            }
+            payload.word(router->is_null());
+            auto coordinate = router->coordinate();
+            payload.word(coordinate.has_value());
+            if (coordinate) {
+                payload.real(coordinate->latitude());
+                payload.real(coordinate->longitude());
+            }
+            payload.word(router->interfaces().size());
+            for (const auto& inf : router->interfaces()) {
+                payload.string(router->interface_name(inf->id()));
+                payload.word(inf->global_id());
+                payload.word(inf->match() == nullptr ? none : inf->match()->global_id());
+                payload.word(inf->weight);
+                payload.word(static_cast<uint64_t>(inf->edge_identification()));
+            }
+        }
+        for (const auto& router : network.routers()) {
+            payload.word(router->tables().size());
+            for (const auto& table : router->tables()) {
+                payload.word(table->interfaces().size());
+                for (const auto& inf : table->interfaces()) {
+                    payload.word(inf->global_id());
+                }
+                payload.word(table->out_interfaces().size());
+                for (const auto& inf : table->out_interfaces()) {
+                    payload.word(inf->global_id());
+                }
+                payload.word(table->entries().size());
+                for (const auto& entry : table->entries()) {
+                    payload.word(entry._top_label);
+                    payload.word(entry._rules.size());
+                    for (const auto& rule : entry._rules) {
+                        payload.word(rule._via == nullptr ? none : rule._via->global_id());
+                        payload.word(rule._priority);
+                        payload.word(rule._weight);
+                        payload.word(rule._ops.size());
+                        for (const auto& op : rule._ops) {
+                            payload.word(static_cast<uint64_t>(op._op));
+                            payload.word(op._op_label);
+                        }
+                    }
+                }
+            }
+        }
+
+        const auto& words = payload.words();
+        auto data = reinterpret_cast<const char*>(words.data());
+        header_t header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.byte_order = byte_order_mark;
+        header.payload_words = words.size();
+        header.checksum = checksum(data, words.size());
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(data, static_cast<std::streamsize>(words.size() * word_size));
+    }
+
+    Network NetworkSnapshot::load(const std::string& file_name) {
+#if defined(__unix__) || defined(__APPLE__)
+        auto fd = ::open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw base_error("error: Could not open network snapshot " + file_name);
+        }
+        struct stat status{};
+        if (::fstat(fd, &status) != 0 || status.st_size == 0) {
+            ::close(fd);
+            throw base_error("error: Could not read network snapshot " + file_name);
+        }
+        auto size = static_cast<size_t>(status.st_size);
+        auto data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping keeps its own reference to the file. It is only used while decoding, and unmapped before returning.
+        if (data == MAP_FAILED) {
+            throw base_error("error: Could not map network snapshot " + file_name);
+        }
+        ::posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+        struct unmap_t {
+            void* data;
+            size_t size;
+            ~unmap_t() { ::munmap(data, size); }
+        } unmap{data, size};
+        return load(static_cast<const char*>(data), size);
+#else
+        std::ifstream in(file_name, std::ios::binary);
+        if (!in.is_open()) {
+            throw base_error("error: Could not open network snapshot " + file_name);
+        }
+        std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return load(data.data(), data.size());
+#endif
+    }
+
+    Network NetworkSnapshot::load(const char* data, size_t size) {
+        header_t header{};
+        if (size < sizeof(header)) {
+            throw base_error("error: Not a network snapshot.");
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+            throw base_error("error: Not a network snapshot.");
+        }
+        if (header.version != version) {
+            throw base_error("error: Network snapshot has version " + std::to_string(header.version) + ", but version " + std::to_string(version) + " is required.");
+        }
+        if (header.byte_order != byte_order_mark) {
+            throw base_error("error: Network snapshot was written on a machine with a different byte order.");
+        }
+        if (header.payload_words != (size - sizeof(header)) / word_size || (size - sizeof(header)) % word_size != 0) {
+            throw base_error("error: Network snapshot is truncated.");
+        }
+        data += sizeof(header);
+        if (checksum(data, header.payload_words) != header.checksum) {
+            throw base_error("error: Network snapshot checksum mismatch.");
+        }
+
+        snapshot_reader in(data, header.payload_words);
+        auto name = in.string();
+        auto router_count = in.count();
+        auto interface_count = in.count();
+        Network::routermap_t mapping;
+        std::vector<std::unique_ptr<Router>> routers;
+        routers.reserve(router_count);
+        std::vector<Interface*> interfaces(interface_count, nullptr);
+        std::vector<uint64_t> matches(interface_count, none);
+        std::vector<const Interface*> inserted; // Router::insert_interface appends here. The global ids are restored from the snapshot.
+        auto interface_at = [&interfaces](uint64_t global_id) -> Interface* {
+            if (global_id >= interfaces.size() || interfaces[global_id] == nullptr) {
+                throw base_error("error: Network snapshot refers to an unknown interface.");
+            }
+            return interfaces[global_id];
+        };
+
+        for (size_t i = 0; i < router_count; ++i) {
+            std::vector<std::string> names(in.count());
+            for (auto& router_name : names) {
+                router_name = in.string();
+            }
+            auto is_null = in.word() != 0;
+            auto router = routers.emplace_back(std::make_unique<Router>(i, names, is_null)).get();
+            if (in.word() != 0) {
+                auto latitude = in.real();
+                auto longitude = in.real();
+                router->set_coordinate(Coordinate(latitude, longitude));
+            }
+            for (const auto& router_name : names) {
+                mapping[router_name] = router;
+            }
+            auto router_interfaces = in.count();
+            for (size_t j = 0; j < router_interfaces; ++j) {
+                auto [fresh, inf] = router->insert_interface(in.string(), inserted, false);
+                auto global_id = in.word();
+                if (!fresh || global_id >= interface_count || interfaces[global_id] != nullptr) {
+                    throw base_error("error: Network snapshot has inconsistent interfaces.");
+                }
+                inf->set_global_id(global_id);
+                interfaces[global_id] = inf;
+                matches[global_id] = in.word();
+                inf->weight = static_cast<uint32_t>(in.word());
+                auto edge_identification = in.word();
+                if (edge_identification > static_cast<uint64_t>(Interface::edge_identification_t::INTERFACE)) {
+                    throw base_error("error: Network snapshot has inconsistent interfaces.");
+                }
+                inf->set_edge_identification(static_cast<Interface::edge_identification_t>(edge_identification));
+            }
+        }
+        if (inserted.size() != interface_count) {
+            throw base_error("error: Network snapshot has inconsistent interfaces.");
+        }
+        for (size_t global_id = 0; global_id < interface_count; ++global_id) {
+            if (matches[global_id] != none) {
+                interfaces[global_id]->make_pairing(interface_at(matches[global_id]));
+            }
+        }
+
+        for (const auto& router : routers) {
+            auto table_count = in.count();
+            for (size_t i = 0; i < table_count; ++i) {
+                auto table = router->emplace_table();
+                auto table_interfaces = in.count();
+                for (size_t j = 0; j < table_interfaces; ++j) {
+                    auto inf = interface_at(in.word());
+                    if (inf->source() != router.get() || inf->table() != nullptr) {
+                        throw base_error("error: Network snapshot has inconsistent tables.");
+                    }
+                    inf->set_table(table);
+                }
+                std::vector<const Interface*> out_interfaces(in.count());
+                for (auto& inf : out_interfaces) {
+                    inf = interface_at(in.word());
+                }
+                table->set_out_interfaces(std::move(out_interfaces));
+                auto entry_count = in.count();
+                for (size_t j = 0; j < entry_count; ++j) {
+                    auto& entry = table->emplace_entry(static_cast<size_t>(in.word()));
+                    auto rule_count = in.count();
+                    entry._rules.reserve(rule_count);
+                    for (size_t k = 0; k < rule_count; ++k) {
+                        auto via_id = in.word();
+                        auto via = via_id == none ? nullptr : interface_at(via_id);
+                        auto priority = static_cast<size_t>(in.word());
+                        auto weight = static_cast<uint32_t>(in.word());
+                        std::vector<RoutingTable::action_t> ops(in.count());
+                        for (auto& op : ops) {
+                            auto op_type = in.word();
+                            if (op_type > static_cast<uint64_t>(RoutingTable::op_t::SWAP)) {
+                                throw base_error("error: Network snapshot has an unknown operation.");
+                            }
+                            op._op = static_cast<RoutingTable::op_t>(op_type);
+                            op._op_label = static_cast<size_t>(in.word());
+                        }
+                        entry._rules.emplace_back(std::move(ops), via, priority, weight);
+                    }
+                }
+            }
+        }
+        if (!in.done()) {
+            throw base_error("error: Network snapshot has trailing data.");
+        }
+
+        Network network(std::move(mapping), std::move(routers), std::vector<const Interface*>(interfaces.begin(), interfaces.end()));
+        network.name = std::move(name);
+        return network;
+    }
+
+}
@@ -117,32 +117,19 @@ namespace aalwines
     }
 
 
-    Builder::labelset_t Builder::all_labels() {
-        if(_label_cache.empty()) {
-            std::unordered_set<Query::label_t> res;
-            res.insert(Query::unused_label()); // This label will 'match' any label in the query that is not present in the network.
-            res.insert(Query::bottom_of_stack()); // This label is used in the PDA construction to represent the bottom of the stack.
-            for (const auto& r : _network.routers()) {
-                for (const auto& table : r->tables()) {
-                    for (const auto& e : table->entries()) {
-                        if (!e.ignores_label()) res.insert(e._top_label);
-                        for (const auto& f : e._rules) {
-                            for (const auto& o : f._ops) {
-                                switch (o._op) {
-                                    case RoutingTable::op_t::SWAP:
-                                    case RoutingTable::op_t::PUSH:
-                                        res.insert(o._op_label);
-                                    default:
-                                        break;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-            _label_cache = res;
-        }
-        return _label_cache;
+    const LabelDictionary& Builder::label_dictionary() {
+        std::call_once(_label_dictionary->_flag, [this](){ _label_dictionary->_dictionary.emplace(_network); });
+        return _label_dictionary->_dictionary.value();
+    }
+
+    const RuleTemplates& Builder::rule_templates() {
+        std::call_once(_rule_templates->_flag, [this](){ _rule_templates->_templates.emplace(_network); });
+        return _rule_templates->_templates.value();
+    }
+
+    const CompiledNetwork& Builder::compiled_network() {
+        std::call_once(_compiled_network->_flag, [this](){ _compiled_network->_compiled.emplace(_network, rule_templates()); });
+        return _compiled_network->_compiled.value();
     }
 
 }
@@ -28,6 +28,9 @@
 #include "aalwines/model/Query.h"
 #include "aalwines/model/Network.h"
 #include "aalwines/model/filter.h"
+#include "aalwines/model/LabelDictionary.h"
+#include "aalwines/model/RuleTemplates.h"
+#include "aalwines/model/CompiledNetwork.h"
 
 #include <string>
 #include <sstream>
@@ -40,6 +43,8 @@
 #include <queue>
 #include <functional>
 #include <unordered_set>
+#include <mutex>
+#include <optional>
 
 namespace std {
 
@@ -69,7 +74,12 @@ namespace aalwines {
         int do_parse(std::istream &stream);
 
         using labelset_t = std::unordered_set<Query::label_t>;
-        labelset_t all_labels();
+        // Built on first use (thread-safe) and shared by all queries.
+        const LabelDictionary& label_dictionary();
+        const labelset_t& all_labels() { return label_dictionary().label_set(); }
+        const RuleTemplates& rule_templates();
+        // Use after the network is pre-processed.
+        const CompiledNetwork& compiled_network();
 
 	    // Building
 	    void path_mode() { _pathmode = true; }
@@ -109,7 +119,22 @@ namespace aalwines {
         bool _inverted = false;
 
     private:
-        labelset_t _label_cache;
+        // Shared between copies of the builder, since they refer to the same network.
+        struct label_dictionary_cache_t {
+            std::once_flag _flag;
+            std::optional<LabelDictionary> _dictionary;
+        };
+        std::shared_ptr<label_dictionary_cache_t> _label_dictionary = std::make_shared<label_dictionary_cache_t>();
+        struct rule_templates_cache_t {
+            std::once_flag _flag;
+            std::optional<RuleTemplates> _templates;
+        };
+        std::shared_ptr<rule_templates_cache_t> _rule_templates = std::make_shared<rule_templates_cache_t>();
+        struct compiled_network_cache_t {
+            std::once_flag _flag;
+            std::optional<CompiledNetwork> _compiled;
+        };
+        std::shared_ptr<compiled_network_cache_t> _compiled_network = std::make_shared<compiled_network_cache_t>();
     };
 }
 
@@ -0,0 +1,107 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   flat_id_set.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_FLAT_ID_SET_H
+#define AALWINES_FLAT_ID_SET_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace aalwines::utils {
+
+    // Finalizer of splitmix64. Spreads the bits of e.g. pointers, whose low bits are always zero.
+    constexpr uint64_t mix_hash(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    /**
+     * Set of small fixed-size keys that assigns dense ids in insertion order, with the same interface as ptrie_set for
+     * the parts used by the PDA construction (insert, at, size).
+     * Keys are stored once in a vector, and looked up through an open addressing (linear probing) table of ids.
+     */
+    template<typename Key, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+    class flat_id_set {
+        static constexpr size_t empty_slot = std::numeric_limits<size_t>::max();
+    public:
+        // Returns whether the key was inserted (i.e. was not there already), and the id of the key.
+        std::pair<bool,size_t> insert(const Key& key) {
+            if ((_keys.size() + 1) * 4 > _slots.size() * 3) {
+                grow();
+            }
+            auto slot = find_slot(key);
+            if (_slots[slot] != empty_slot) {
+                return std::make_pair(false, _slots[slot]);
+            }
+            auto id = _keys.size();
+            _slots[slot] = id;
+            _keys.push_back(key);
+            return std::make_pair(true, id);
+        }
+
+        [[nodiscard]] std::optional<size_t> find(const Key& key) const {
+            if (_slots.empty()) return std::nullopt;
+            auto id = _slots[find_slot(key)];
+            if (id == empty_slot) return std::nullopt;
+            return id;
+        }
+
+        [[nodiscard]] const Key& at(size_t id) const { return _keys[id]; }
+        [[nodiscard]] size_t size() const { return _keys.size(); }
+        [[nodiscard]] bool empty() const { return _keys.empty(); }
+
+    private:
+        // The slot containing key, or the empty slot where it should be inserted.
+        [[nodiscard]] size_t find_slot(const Key& key) const {
+            auto mask = _slots.size() - 1;
+            for (auto slot = static_cast<size_t>(Hash{}(key)) & mask; ; slot = (slot + 1) & mask) {
+                auto id = _slots[slot];
+                if (id == empty_slot || KeyEqual{}(_keys[id], key)) return slot;
+            }
+        }
+        void grow() {
+            _slots.assign(std::max<size_t>(_slots.size() * 2, 16), empty_slot);
+            auto mask = _slots.size() - 1;
+            for (size_t id = 0; id < _keys.size(); ++id) {
+                auto slot = static_cast<size_t>(Hash{}(_keys[id])) & mask;
+                while (_slots[slot] != empty_slot) {
+                    slot = (slot + 1) & mask;
+                }
+                _slots[slot] = id;
+            }
+        }
+
+        std::vector<Key> _keys;
+        std::vector<size_t> _slots; // Size is a power of two.
+    };
+
+}
+
+#endif //AALWINES_FLAT_ID_SET_H
@@ -27,13 +27,14 @@
 #ifndef OUTCOME_H
 #define OUTCOME_H
 
+#include <aalwines/utils/errors.h>
 #include <ostream>
 #include <nlohmann/json.hpp>
 
 namespace aalwines::utils {
-    enum class outcome_t { YES, NO, MAYBE };
+    enum class outcome_t { YES, NO, MAYBE, TIMEOUT, MEMOUT };
 
-    std::ostream& operator<<(std::ostream& os, const outcome_t& outcome) {
+    inline std::ostream& operator<<(std::ostream& os, const outcome_t& outcome) {
         switch (outcome) {
             case outcome_t::YES:
                 os << "YES";
@@ -44,6 +45,12 @@ namespace aalwines::utils {
             case outcome_t::MAYBE:
                 os << "MAYBE";
                 break;
+            case outcome_t::TIMEOUT:
+                os << "TIMEOUT";
+                break;
+            case outcome_t::MEMOUT:
+                os << "MEMOUT";
+                break;
         }
         return os;
     }
@@ -58,8 +65,12 @@ namespace aalwines::utils {
             } else {
                 outcome = outcome_t::NO;
             }
+        } else if (j.is_string() && j.get<std::string>() == "TIMEOUT") {
+            outcome = outcome_t::TIMEOUT;
+        } else if (j.is_string() && j.get<std::string>() == "MEMOUT") {
+            outcome = outcome_t::MEMOUT;
         } else {
-            throw base_error("error: outcome must be either true, false or null.");
+            throw base_error("error: outcome must be either true, false, null, \"TIMEOUT\" or \"MEMOUT\".");
         }
     }
     inline void to_json(json & j, const outcome_t& outcome) {
@@ -73,6 +84,12 @@ namespace aalwines::utils {
             case outcome_t::MAYBE:
                 j = nullptr;
                 break;
+            case outcome_t::TIMEOUT:
+                j = "TIMEOUT";
+                break;
+            case outcome_t::MEMOUT:
+                j = "MEMOUT";
+                break;
         }
     }
 }
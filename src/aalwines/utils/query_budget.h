@@ -0,0 +1,103 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   query_budget.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_QUERY_BUDGET_H
+#define AALWINES_QUERY_BUDGET_H
+
+#include <aalwines/utils/outcome.h>
+#include <aalwines/utils/system.h>
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+
+namespace aalwines::utils {
+
+    // Thrown from a checkpoint when the budget of the running query is used up.
+    class budget_exceeded : public std::exception {
+    public:
+        explicit budget_exceeded(outcome_t outcome) : _outcome(outcome) { }
+        [[nodiscard]] outcome_t outcome() const { return _outcome; }
+        [[nodiscard]] const char* what() const noexcept override {
+            switch (_outcome) {
+                case outcome_t::TIMEOUT:
+                    return "query timeout";
+                case outcome_t::MEMOUT:
+                    return "process memory limit exceeded";
+                default:
+                    return "query cancelled";
+            }
+        }
+    private:
+        outcome_t _outcome;
+    };
+
+    /**
+     * Wall-clock budget of a single query and memory limit of the process, with cooperative cancellation.
+     * Long-running loops call check() regularly, which throws budget_exceeded when the time limit is reached,
+     * the memory limit is exceeded or cancel() was called (possibly from another thread).
+     * The memory limit is not per query: it is compared to the resident memory of the whole process, which includes
+     * memory the allocator kept from earlier queries. It is only sampled every few checks. So a memory limit is only
+     * meaningful when one query runs at a time (Verifier::check_settings rejects it with --threads other than 1).
+     * The checks are in aalwines code only; the post*, pre* and dual* loops inside pdaaal run until they return.
+     * A limit of 0 means unlimited.
+     */
+    class query_budget {
+        using clock = std::chrono::steady_clock;
+        static constexpr size_t memory_sample_interval = 4096;
+    public:
+        query_budget() = default;
+        query_budget(double timeout_seconds, size_t process_memory_limit_bytes)
+        : _has_deadline(timeout_seconds > 0), _memory_limit(process_memory_limit_bytes),
+          _deadline(clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(timeout_seconds))) { }
+
+        void cancel() { _cancelled = true; }
+        [[nodiscard]] bool cancelled() const { return _cancelled; }
+        [[nodiscard]] bool unlimited() const { return !_has_deadline && _memory_limit == 0; }
+
+        void check() const {
+            if (_cancelled) {
+                throw budget_exceeded(outcome_t::MAYBE);
+            }
+            if (_has_deadline && clock::now() >= _deadline) {
+                throw budget_exceeded(outcome_t::TIMEOUT);
+            }
+            if (_memory_limit != 0 && _checks++ % memory_sample_interval == 0 && resident_memory() > _memory_limit) {
+                throw budget_exceeded(outcome_t::MEMOUT);
+            }
+        }
+
+        // Convenience for code that may or may not run with a budget.
+        static void check(const query_budget* budget) {
+            if (budget != nullptr) budget->check();
+        }
+
+    private:
+        bool _has_deadline = false;
+        size_t _memory_limit = 0;
+        clock::time_point _deadline;
+        std::atomic<bool> _cancelled = false;
+        mutable std::atomic<size_t> _checks = 0;
+    };
+
+}
+
+#endif //AALWINES_QUERY_BUDGET_H
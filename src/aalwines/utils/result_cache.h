@@ -0,0 +1,134 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   result_cache.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_RESULT_CACHE_H
+#define AALWINES_RESULT_CACHE_H
+
+#include <aalwines/utils/errors.h>
+
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+namespace aalwines::utils {
+
+    // 64 bit FNV-1a hash. Continue hashing by passing the previous result as hash.
+    inline uint64_t fnv1a_64(std::string_view data, uint64_t hash = 14695981039346656037ULL) {
+        for (unsigned char c : data) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+    inline std::string to_hex(uint64_t value) {
+        std::stringstream ss;
+        ss << std::hex << std::setw(16) << std::setfill('0') << value;
+        return ss.str();
+    }
+
+    // Collapse runs of whitespace to a single space and trim both ends.
+    inline std::string normalize_whitespace(std::string_view text) {
+        std::string result;
+        bool space = false;
+        for (char c : text) {
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                space = !result.empty();
+            } else {
+                if (space) result.push_back(' ');
+                space = false;
+                result.push_back(c);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * On-disk cache of JSON answers. Each entry is a file in the cache directory named by the hash of its key.
+     * The full key is stored in the file as well, so hash collisions are detected and treated as misses.
+     * Entries are written to a temporary file and then renamed, so concurrent readers never see partial entries.
+     */
+    class result_cache {
+        using json = nlohmann::json;
+    public:
+        explicit result_cache(std::filesystem::path directory) : _directory(std::move(directory)) {
+            std::error_code ec;
+            std::filesystem::create_directories(_directory, ec);
+            if (ec) {
+                throw base_error("error: Could not create result cache directory " + _directory.string() + ": " + ec.message());
+            }
+        }
+
+        [[nodiscard]] std::optional<json> lookup(const std::string& key) const {
+            std::ifstream in(entry_path(key));
+            if (!in.is_open()) return std::nullopt;
+            try {
+                json entry;
+                in >> entry;
+                if (entry.is_object() && entry.contains("key") && entry["key"] == key && entry.contains("answer")) {
+                    return std::move(entry["answer"]);
+                }
+            } catch (const json::exception&) {
+                // Unreadable entry. Treat as a miss, and let store() overwrite it.
+            }
+            return std::nullopt;
+        }
+
+        void store(const std::string& key, const json& answer) const {
+            auto path = entry_path(key);
+            std::stringstream tmp_name;
+            tmp_name << path.filename().string() << ".tmp." << std::this_thread::get_id() << "." << std::random_device()();
+            auto tmp_path = _directory / tmp_name.str();
+            {
+                std::ofstream out(tmp_path);
+                if (!out.is_open()) return; // The cache is only an optimization, so failing to write is not an error.
+                json entry;
+                entry["key"] = key;
+                entry["answer"] = answer;
+                out << entry << std::endl;
+            }
+            std::error_code ec;
+            std::filesystem::rename(tmp_path, path, ec);
+            if (ec) {
+                std::filesystem::remove(tmp_path, ec);
+            }
+        }
+
+    private:
+        [[nodiscard]] std::filesystem::path entry_path(const std::string& key) const {
+            return _directory / (to_hex(fnv1a_64(key)) + ".json");
+        }
+
+        std::filesystem::path _directory;
+    };
+
+}
+
+#endif //AALWINES_RESULT_CACHE_H
@@ -25,6 +25,10 @@
 #include <stdexcept>
 #include <string>
 #include <array>
+#include <fstream>
+#if defined(__unix__)
+#include <unistd.h>
+#endif
 
 // Blatantly stolen from https://stackoverflow.com/questions/478898/how-do-i-execute-a-command-and-get-output-of-command-within-c-using-posix
 #include <sstream>
@@ -54,3 +58,15 @@ std::string get_env_var(const char* key)
     char * val = getenv(key);
     return val == nullptr ? std::string("") : std::string(val);
 }
+
+size_t resident_memory()
+{
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0, resident_pages = 0;
+    if (statm >> total_pages >> resident_pages) {
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
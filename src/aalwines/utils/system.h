@@ -32,6 +32,7 @@
 std::string exec(const char* cmd);
 std::string get_env_var( std::string const & key );
 std::string get_env_var( const char* key );
+size_t resident_memory(); // Resident set size of this process in bytes, or 0 if it cannot be determined.
 
 #endif /* SYSTEM_H */
 
@@ -0,0 +1,177 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/*
+ * File:   task_race.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_TASK_RACE_H
+#define AALWINES_TASK_RACE_H
+
+#include <aalwines/utils/query_budget.h>
+#include <aalwines/utils/stopwatch.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace aalwines::utils {
+
+    /**
+     * Runs tasks on their own threads, each with its own query_budget, and returns as soon as one of them gives a conclusive output.
+     * The other tasks are then cancelled through their budget. A task only stops at its next budget check, so the race does not
+     * wait for them: each task owns its state (shared with its thread), and threads that are still running are joined by a later
+     * run() once they have stopped, or at the latest by the destructor.
+     * Tasks must not refer to anything that is destroyed before the task_race.
+     */
+    class task_race {
+    public:
+        using json = nlohmann::json;
+        using task_t = std::function<json(const query_budget&)>;
+        using conclusive_t = std::function<bool(const json&)>;
+
+        struct result_t {
+            std::optional<json> output; // Empty if the task failed, or was still running when the race was decided.
+            std::exception_ptr error;
+            bool cancelled = false;
+            double time = 0; // Only for tasks that finished before the race was decided.
+        };
+
+        task_race() = default;
+        ~task_race() {
+            wait();
+        }
+        task_race(const task_race&) = delete;
+        task_race& operator=(const task_race&) = delete;
+
+        // Blocks until the tasks of earlier races have stopped.
+        void wait() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto& [thread, state] : _threads) {
+                thread.join();
+            }
+            _threads.clear();
+        }
+
+        // Returns the index of the first task with a conclusive output (if any), and the results of all tasks as they were at that time.
+        std::pair<std::optional<size_t>, std::vector<result_t>> run(std::vector<task_t>&& tasks, const conclusive_t& conclusive,
+                                                                   double timeout_seconds, size_t memory_limit_bytes) {
+            join_finished();
+            auto race = std::make_shared<race_t>();
+            for (auto& task : tasks) {
+                race->_tasks.emplace_back(std::make_shared<state_t>(std::move(task), timeout_seconds, memory_limit_bytes));
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (size_t i = 0; i < race->_tasks.size(); ++i) {
+                    _threads.emplace_back(std::thread([race, i, conclusive](){ race->run(i, conclusive); }), race->_tasks[i]);
+                }
+            }
+
+            std::unique_lock<std::mutex> lock(race->_mutex);
+            race->_changed.wait(lock, [&race](){ return race->_winner || race->_finished == race->_tasks.size(); });
+            std::vector<result_t> results(race->_tasks.size());
+            for (size_t i = 0; i < results.size(); ++i) {
+                auto& state = *race->_tasks[i];
+                results[i].cancelled = state._budget.cancelled();
+                if (!state._finished) continue;
+                results[i].error = state._error;
+                results[i].time = state._time;
+                if (!state._error) {
+                    results[i].output = std::move(state._output);
+                }
+            }
+            return {race->_winner, std::move(results)};
+        }
+
+    private:
+        struct state_t {
+            state_t(task_t&& task, double timeout_seconds, size_t memory_limit_bytes)
+            : _task(std::move(task)), _budget(timeout_seconds, memory_limit_bytes) { }
+            task_t _task;
+            query_budget _budget;
+            // Written by the thread of the task before _finished is set (under race_t::_mutex).
+            json _output;
+            std::exception_ptr _error;
+            double _time = 0;
+            std::atomic<bool> _finished = false;
+        };
+        struct race_t {
+            void run(size_t i, const conclusive_t& conclusive) {
+                auto& state = *_tasks[i];
+                stopwatch time;
+                json output;
+                std::exception_ptr error;
+                try {
+                    output = state._task(state._budget);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                time.stop();
+                std::lock_guard<std::mutex> lock(_mutex);
+                state._output = std::move(output);
+                state._error = error;
+                state._time = time.duration();
+                state._finished = true;
+                ++_finished;
+                if (!error && !_winner && conclusive(state._output)) {
+                    _winner = i;
+                    for (size_t j = 0; j < _tasks.size(); ++j) {
+                        if (j != i) _tasks[j]->_budget.cancel();
+                    }
+                }
+                _changed.notify_all();
+            }
+
+            std::vector<std::shared_ptr<state_t>> _tasks;
+            std::mutex _mutex; // Protects the members below, and the results in _tasks.
+            std::condition_variable _changed;
+            std::optional<size_t> _winner;
+            size_t _finished = 0;
+        };
+
+        void join_finished() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto it = _threads.begin(); it != _threads.end();) {
+                if (it->second->_finished) {
+                    it->first.join();
+                    it = _threads.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        std::mutex _mutex; // Protects _threads.
+        std::list<std::pair<std::thread, std::shared_ptr<const state_t>>> _threads;
+    };
+
+}
+
+#endif //AALWINES_TASK_RACE_H
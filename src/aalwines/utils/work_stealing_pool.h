@@ -0,0 +1,150 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   work_stealing_pool.h
+ *
+ * Created on 17-10-2026.
+ */
+
+#ifndef AALWINES_WORK_STEALING_POOL_H
+#define AALWINES_WORK_STEALING_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aalwines::utils {
+
+    /**
+     * Fixed size thread pool. Each worker owns a queue of tasks, takes work from the front of its own queue,
+     * and when that is empty it steals from the back of the queues of the other workers.
+     * Tasks are expected to handle their own exceptions.
+     */
+    class work_stealing_pool {
+    public:
+        using task_t = std::function<void()>;
+
+        explicit work_stealing_pool(size_t threads) : _queues(std::max<size_t>(threads, 1)) {
+            _workers.reserve(_queues.size());
+            for (size_t i = 0; i < _queues.size(); ++i) {
+                _workers.emplace_back([this, i](){ work(i); });
+            }
+        }
+        ~work_stealing_pool() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _work_available.notify_all();
+            for (auto& worker : _workers) {
+                worker.join();
+            }
+        }
+        work_stealing_pool(const work_stealing_pool&) = delete;
+        work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+        [[nodiscard]] size_t size() const { return _workers.size(); }
+
+        // Use 0 to mean 'as many as the hardware supports'.
+        static size_t resolve_threads(size_t threads) {
+            return threads != 0 ? threads : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        void submit(task_t task) {
+            // Count the task before it is visible in a queue. Otherwise a worker could take (and finish) it first and wrap the counters below zero.
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                ++_queued;
+                ++_unfinished;
+            }
+            auto& queue = _queues[_next_queue++ % _queues.size()];
+            {
+                std::lock_guard<std::mutex> lock(queue._mutex);
+                queue._tasks.push_back(std::move(task));
+            }
+            _work_available.notify_one();
+        }
+
+        // Blocks until all submitted tasks have finished.
+        void wait() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _all_done.wait(lock, [this](){ return _unfinished == 0; });
+        }
+
+    private:
+        struct queue_t {
+            std::mutex _mutex;
+            std::deque<task_t> _tasks;
+        };
+
+        void work(size_t self) {
+            task_t task;
+            while (true) {
+                if (take(self, task)) {
+                    task();
+                    task = nullptr;
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (--_unfinished == 0) {
+                        _all_done.notify_all();
+                    }
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(_mutex);
+                _work_available.wait(lock, [this](){ return _queued > 0 || _stop; });
+                if (_queued == 0) return; // Stopped and no more work.
+            }
+        }
+
+        bool take(size_t self, task_t& task) {
+            for (size_t i = 0; i < _queues.size(); ++i) {
+                auto& queue = _queues[(self + i) % _queues.size()];
+                std::unique_lock<std::mutex> queue_lock(queue._mutex);
+                if (queue._tasks.empty()) continue;
+                if (i == 0) { // Own queue
+                    task = std::move(queue._tasks.front());
+                    queue._tasks.pop_front();
+                } else { // Steal
+                    task = std::move(queue._tasks.back());
+                    queue._tasks.pop_back();
+                }
+                queue_lock.unlock();
+                std::lock_guard<std::mutex> lock(_mutex);
+                --_queued;
+                return true;
+            }
+            return false;
+        }
+
+        std::vector<queue_t> _queues;
+        std::vector<std::thread> _workers;
+        std::atomic<size_t> _next_queue = 0;
+
+        std::mutex _mutex; // Protects the counters below.
+        std::condition_variable _work_available;
+        std::condition_variable _all_done;
+        size_t _queued = 0;     // Tasks waiting in a queue.
+        size_t _unfinished = 0; // Tasks submitted, but not yet finished.
+        bool _stop = false;
+    };
+
+}
+
+#endif //AALWINES_WORK_STEALING_POOL_H
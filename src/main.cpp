@@ -27,6 +27,7 @@
 
 #include <aalwines/model/builders/AalWiNesBuilder.h>
 #include <aalwines/model/builders/TopologyBuilder.h>
+#include <aalwines/model/builders/NetworkSnapshot.h>
 
 #include <aalwines/model/NetworkPDAFactory.h>
 #include <aalwines/model/NetworkWeight.h>
@@ -35,6 +36,7 @@
 #include <aalwines/utils/stopwatch.h>
 #include <aalwines/utils/outcome.h>
 #include <aalwines/Verifier.h>
+#include <aalwines/VerificationServer.h>
 
 #include <aalwines/model/builders/NetworkParsing.h>
 
@@ -44,6 +46,7 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include "version.h" // Generated at build time. Defines AALWINES_GIT_HASH, AALWINES_GIT_HASH_STR, AALWINES_VERSION and AALWINES_VERSION_STR
 
 namespace po = boost::program_options;
@@ -74,7 +77,7 @@ int main(int argc, const char** argv)
     bool no_parser_warnings = false;
     bool silent = false;
     bool no_timing = false;
-    std::string json_destination, json_pretty_destination, json_topo_destination;
+    std::string json_destination, json_pretty_destination, json_topo_destination, snapshot_destination;
 
     output.add_options()
             ("dot", po::bool_switch(&print_dot), "A dot output will be printed to cout when set.")
@@ -87,6 +90,7 @@ int main(int argc, const char** argv)
             ("write-json", po::value<std::string>(&json_destination), "Write the network in the AalWiNes MPLS Network format to the given file.")
             ("write-json-pretty", po::value<std::string>(&json_pretty_destination), "Pretty print the network in the AalWiNes MPLS Network format to the given file.")
             ("write-json-topology", po::value<std::string>(&json_topo_destination), "Write the topology of the network in the AalWiNes MPLS Network format to the given file.")
+            ("write-snapshot", po::value<std::string>(&snapshot_destination), "Write the pre-processed network as a binary snapshot to the given file. Load it again with --snapshot.")
     ;
 
     std::string query_file;
@@ -95,9 +99,18 @@ int main(int argc, const char** argv)
             ("query,q", po::value<std::string>(&query_file), "A file containing valid queries over the input network.")
             ("weight,w", po::value<std::string>(&weight_file), "A file containing the weight function expression");
 
+    po::options_description server_opts("Server Options");
+    bool server_mode = false;
+    std::string socket_path;
+    server_opts.add_options()
+            ("server", po::bool_switch(&server_mode), "Keep the network in memory and answer queries read as newline delimited JSON from stdin.")
+            ("socket", po::value<std::string>(&socket_path), "Like --server, but accept connections on a Unix domain socket at the given path.")
+    ;
+
     opts.add(parser.options());
     opts.add(output);
     opts.add(verifier.options());
+    opts.add(server_opts);
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, opts), vm);
@@ -164,6 +177,57 @@ int main(int argc, const char** argv)
             exit(-1);
         }
     }
+    if (!snapshot_destination.empty()) {
+        std::ofstream out(snapshot_destination, std::ios::binary);
+        if(out.is_open()) {
+            NetworkSnapshot::write(network, out);
+        } else {
+            std::cerr << "Could not open --write-snapshot\"" << snapshot_destination << "\" for writing" << std::endl;
+            exit(-1);
+        }
+    }
+    std::optional<NetworkWeight::weight_function> weight_fn;
+    std::string weight_key; // Identifies the weight function in the result cache.
+    if (!weight_file.empty()) {
+        NetworkWeight network_weight;
+        {
+            std::ifstream wstream(weight_file);
+            if (!wstream.is_open()) {
+                std::cerr << "Could not open Weight-file\"" << weight_file << "\"" << std::endl;
+                exit(-1);
+            }
+            try {
+                weight_key.assign(std::istreambuf_iterator<char>(wstream), std::istreambuf_iterator<char>());
+                std::istringstream weight_stream(weight_key);
+                weight_fn.emplace(network_weight.parse(weight_stream));
+            } catch (base_error& error) {
+                std::cerr << "Error while parsing weight function:" << error << std::endl;
+                exit(-1);
+            } catch (nlohmann::detail::parse_error& error) {
+                std::cerr << "Error while parsing weight function:" << error.what() << std::endl;
+                exit(-1);
+            }
+        }
+    }
+
+    verifier.set_weight_key(weight_key);
+
+    if (server_mode || !socket_path.empty()) {
+        if (verifier.engine() == 0) {
+            std::cerr << "Server mode requires an --engine to verify queries with." << std::endl;
+            exit(-1);
+        }
+        Builder builder(network);
+        VerificationServer server(builder, verifier, weight_fn, !no_timing, weight_key);
+        if (!socket_path.empty()) {
+            server.serve_unix_socket(socket_path);
+        } else {
+            server.serve(std::cin, std::cout);
+        }
+        verifier.wait_for_cancelled_engines();
+        return 0;
+    }
+
     json_stream json_output;
     if (print_net) {
         network.print_json(json_output);
@@ -196,31 +260,9 @@ int main(int argc, const char** argv)
         }
         queryparsingwatch.stop();
 
-        std::optional<NetworkWeight::weight_function> weight_fn;
-        if (!weight_file.empty()) {
-            NetworkWeight network_weight;
-            {
-                std::ifstream wstream(weight_file);
-                if (!wstream.is_open()) {
-                    std::cerr << "Could not open Weight-file\"" << weight_file << "\"" << std::endl;
-                    exit(-1);
-                }
-                try {
-                    weight_fn.emplace(network_weight.parse(wstream));
-                } catch (base_error& error) {
-                    std::cerr << "Error while parsing weight function:" << error << std::endl;
-                    exit(-1);
-                } catch (nlohmann::detail::parse_error& error) {
-                    std::cerr << "Error while parsing weight function:" << error.what() << std::endl;
-                    exit(-1);
-                }
-            }
-        } else {
-            weight_fn = std::nullopt;
-        }
-
         if(!no_timing) {
             json_output.entry("network-parsing-time", parser.duration());
+            json_output.entry("network-pre-processing-time", parser.pre_processing_duration());
             json_output.entry("query-parsing-time", queryparsingwatch.duration());
         }
 
@@ -229,6 +271,10 @@ int main(int argc, const char** argv)
         } else {
             verifier.run(builder, query_strings, json_output, !no_timing);
         }
+        // The answers are complete, so print them before waiting for cancelled portfolio engines to stop.
+        json_output.close();
+        std::cout << std::endl;
+        verifier.wait_for_cancelled_engines();
     }
 
     return 0;
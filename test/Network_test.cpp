@@ -28,6 +28,13 @@
 
 #include <boost/test/unit_test.hpp>
 #include <aalwines/model/Network.h>
+#include <aalwines/model/NetworkTranslation.h>
+#include <aalwines/model/CompiledNetwork.h>
+#include <aalwines/model/builders/NetworkSnapshot.h>
+#include <aalwines/utils/errors.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
 
 
 using namespace aalwines;
@@ -102,3 +109,165 @@ BOOST_AUTO_TEST_CASE(NetworkCopy) {
     BOOST_CHECK_EQUAL(new_i3->match(), nullptr);
 }
 
+BOOST_AUTO_TEST_CASE(NetworkEdgeIdentification) {
+    Network network("Testnet");
+    auto router1 = network.add_router("router1");
+    auto router2 = network.add_router("router2");
+    auto i0 = network.insert_interface_to("i0", router1).second;
+    auto i1 = network.insert_interface_to("i1", router1).second;
+    auto i2 = network.insert_interface_to("i2", router2).second;
+    auto i3 = network.insert_interface_to("i3", router2).second;
+    i1->make_pairing(i2);
+    i0->table()->add_rule(RoutingTable::label_t("s10"), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t("s11")), i1);
+    i1->table()->add_rule(RoutingTable::label_t("s21"), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t("s22")), i0);
+    i2->table()->add_rule(RoutingTable::label_t("s11"), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t("s12")), i3);
+    i3->table()->add_rule(RoutingTable::label_t("s20"), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t("s21")), i2);
+
+    for (const auto& inf : network.all_interfaces()) {
+        BOOST_CHECK(inf->edge_identification() == Interface::edge_identification_t::UNKNOWN);
+    }
+    network.prepare_tables();
+    network.pre_process();
+
+    Network new_network(network);
+    for (const auto& net : {&network, &new_network}) {
+        for (const auto& inf : net->all_interfaces()) {
+            if (inf->table() == nullptr || inf->match() == nullptr || inf->target() == nullptr) continue;
+            auto expected = NetworkTranslation::identify_edge(inf) == NetworkTranslation::edge_variant(inf->table())
+                ? Interface::edge_identification_t::TABLE : Interface::edge_identification_t::INTERFACE;
+            BOOST_CHECK(inf->edge_identification() == expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(NetworkCompiled) {
+    Network network("Testnet");
+    auto router1 = network.add_router("router1");
+    auto router2 = network.add_router("router2");
+    auto i0 = network.insert_interface_to("i0", router1).second;
+    auto i1 = network.insert_interface_to("i1", router1).second;
+    auto i2 = network.insert_interface_to("i2", router2).second;
+    auto i3 = network.insert_interface_to("i3", router2).second;
+    i1->make_pairing(i2);
+    i0->table()->add_rule(RoutingTable::label_t("s10"), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t("s11")), i1);
+    i1->table()->add_rule(RoutingTable::label_t("s21"), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t("s22")), i0);
+    i2->table()->add_rule(RoutingTable::label_t("s11"), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t("s12")), i3);
+    i3->table()->add_rule(RoutingTable::label_t("s20"), RoutingTable::action_t(RoutingTable::op_t::SWAP, RoutingTable::label_t("s21")), i2);
+    network.prepare_tables();
+    network.pre_process();
+
+    // The arrays of the compiled network describe the same network as the pointers.
+    RuleTemplates templates(network);
+    CompiledNetwork compiled(network, templates);
+    BOOST_CHECK_EQUAL(compiled.number_of_routers(), network.routers().size());
+    BOOST_REQUIRE_EQUAL(compiled.number_of_interfaces(), network.all_interfaces().size());
+    BOOST_CHECK_EQUAL(compiled.number_of_tables(), templates.number_of_tables());
+    for (const auto& inf : network.all_interfaces()) {
+        auto id = inf->global_id();
+        BOOST_CHECK_EQUAL(compiled.interface(id), inf);
+        BOOST_CHECK_EQUAL(compiled.interface_router(id), inf->source()->index());
+        BOOST_CHECK_EQUAL(compiled.interface_match(id), inf->match() == nullptr ? CompiledNetwork::none() : inf->match()->global_id());
+        if (inf->table() != nullptr) {
+            BOOST_CHECK_EQUAL(compiled.table(compiled.interface_table(id)), inf->table());
+        }
+    }
+    for (size_t table_id = 0; table_id < compiled.number_of_tables(); ++table_id) {
+        const auto* table = compiled.table(table_id);
+        std::vector<size_t> out_ids;
+        for (const auto& inf : table->out_interfaces()) out_ids.push_back(inf->global_id());
+        std::sort(out_ids.begin(), out_ids.end());
+        auto out = compiled.table_out_interfaces(table_id);
+        BOOST_CHECK_EQUAL_COLLECTIONS(out.begin(), out.end(), out_ids.begin(), out_ids.end());
+
+        auto entries = compiled.table_entries(table_id);
+        BOOST_REQUIRE_EQUAL(entries._end - entries._begin, table->entries().size());
+        size_t rule = templates.table(table_id).begin() - templates.templates().data(); // Also for tables without rules.
+        for (size_t entry = entries._begin; entry < entries._end; ++entry) {
+            BOOST_CHECK_EQUAL(compiled.entry_top_label(entry), table->entries()[entry - entries._begin]._top_label);
+            auto rules = compiled.entry_rules(entry);
+            BOOST_CHECK_EQUAL(rules._begin, rule);
+            rule = rules._end;
+        }
+    }
+    for (const auto& forward : templates.templates()) {
+        auto rule = templates.index(forward);
+        const auto* target = forward._via->match();
+        if (target == nullptr) {
+            BOOST_CHECK_EQUAL(compiled.rule_target(rule), CompiledNetwork::none());
+            continue;
+        }
+        BOOST_CHECK_EQUAL(compiled.rule_target(rule), target->global_id());
+        BOOST_CHECK_EQUAL(compiled.table(compiled.rule_target_table(rule)), target->table());
+        BOOST_CHECK(compiled.rule_target_edge(rule) == NetworkTranslation::get_edge_pointer(target));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(NetworkSnapshotRoundTrip) {
+    Network network("Testnet");
+    auto router1 = network.add_router("router1", Coordinate(55.7, 12.6));
+    auto router2 = network.add_router("router2");
+    router2->add_name("alias2");
+    auto i0 = network.insert_interface_to("i0", router1).second;
+    auto i1 = network.insert_interface_to("i1", router1).second;
+    auto i2 = network.insert_interface_to("i2", router2).second;
+    auto i3 = network.insert_interface_to("i3", router2).second;
+    i1->make_pairing(i2);
+    i1->weight = 7;
+    i0->table()->add_rule(10, RoutingTable::action_t(RoutingTable::op_t::SWAP, 11), i1);
+    i0->table()->add_rule(10, RoutingTable::action_t(RoutingTable::op_t::PUSH, 12), i1, 3);
+    i1->table()->add_rule(21, RoutingTable::action_t(RoutingTable::op_t::POP), i0);
+    i2->table()->add_rule(Query::wildcard_label(), RoutingTable::action_t(RoutingTable::op_t::SWAP, 12), i3);
+    network.add_null_router();
+    network.prepare_tables();
+    network.pre_process();
+
+    std::stringstream out;
+    NetworkSnapshot::write(network, out);
+    auto data = out.str();
+    auto loaded = NetworkSnapshot::load(data.data(), data.size());
+    BOOST_CHECK(loaded.check_sanity());
+
+    // Writing the loaded network gives the same snapshot, so nothing is lost.
+    std::stringstream again;
+    NetworkSnapshot::write(loaded, again);
+    BOOST_CHECK(again.str() == data);
+
+    BOOST_CHECK_EQUAL(loaded.name, "Testnet");
+    BOOST_REQUIRE_EQUAL(loaded.routers().size(), network.routers().size());
+    BOOST_CHECK(loaded.find_router("router1")->coordinate() == router1->coordinate());
+    BOOST_CHECK_EQUAL(loaded.find_router("alias2"), loaded.find_router("router2"));
+    BOOST_REQUIRE_EQUAL(loaded.all_interfaces().size(), network.all_interfaces().size());
+    for (size_t id = 0; id < network.all_interfaces().size(); ++id) {
+        const auto* inf = network.all_interfaces()[id];
+        const auto* new_inf = loaded.all_interfaces()[id];
+        BOOST_CHECK_EQUAL(new_inf->global_id(), id);
+        BOOST_CHECK_EQUAL(new_inf->get_name(), inf->get_name());
+        BOOST_CHECK_EQUAL(new_inf->source()->index(), inf->source()->index());
+        BOOST_CHECK_EQUAL(new_inf->match() == nullptr ? id : new_inf->match()->global_id(), inf->match() == nullptr ? id : inf->match()->global_id());
+        BOOST_CHECK_EQUAL(new_inf->weight, inf->weight);
+        BOOST_CHECK(new_inf->edge_identification() == inf->edge_identification());
+        BOOST_REQUIRE_EQUAL(new_inf->table() == nullptr, inf->table() == nullptr);
+        if (inf->table() != nullptr) {
+            BOOST_CHECK_EQUAL_COLLECTIONS(new_inf->table()->entries().begin(), new_inf->table()->entries().end(), inf->table()->entries().begin(), inf->table()->entries().end());
+        }
+    }
+    BOOST_CHECK_EQUAL(loaded.find_router("router1")->find_interface("i0")->table()->entries()[0]._rules[0]._via, loaded.find_router("router1")->find_interface("i1"));
+
+    // Through the file mapping.
+    auto file = std::filesystem::temp_directory_path() / "aalwines_snapshot_test.bin";
+    {
+        std::ofstream file_out(file, std::ios::binary);
+        NetworkSnapshot::write(network, file_out);
+    }
+    std::stringstream from_file;
+    NetworkSnapshot::write(NetworkSnapshot::load(file.string()), from_file);
+    BOOST_CHECK(from_file.str() == data);
+    std::filesystem::remove(file);
+
+    // Corrupt snapshots are rejected.
+    auto corrupt = data;
+    corrupt[corrupt.size() - 1] ^= 1;
+    BOOST_CHECK_THROW(NetworkSnapshot::load(corrupt.data(), corrupt.size()), base_error);
+    BOOST_CHECK_THROW(NetworkSnapshot::load(data.data(), data.size() - 8), base_error);
+    BOOST_CHECK_THROW(NetworkSnapshot::load(data.data(), 16), base_error);
+}
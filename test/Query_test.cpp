@@ -29,6 +29,7 @@
 #include <boost/test/unit_test.hpp>
 #include <aalwines/model/Network.h>
 #include <aalwines/Verifier.h>
+#include <aalwines/model/builders/NetworkSAXHandler.h>
 #include <aalwines/synthesis/RouteConstruction.h>
 
 using namespace aalwines;
@@ -113,4 +114,667 @@ BOOST_AUTO_TEST_CASE(QueryTest3) {
         BOOST_CHECK_EQUAL(result, utils::outcome_t::YES);
         BOOST_TEST_MESSAGE(output["trace"]);
     }
-}
\ No newline at end of file
+}
+BOOST_AUTO_TEST_CASE(QueryTestPortfolio) {
+    std::vector<std::string> routers{"Router0", "Router1"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(1)->find_interface("iRouter1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::string query("<42 43> [.#Router0] [Router0#Router1] [Router1#.] <44 43> 0 OVER");
+
+    std::istringstream qstream(query);
+    builder.do_parse(qstream);
+
+    Verifier verifier;
+    verifier.set_engine(8);
+    verifier.set_portfolio("1,2,4");
+    verifier.set_trace_type(pdaaal::Trace_Type::Any);
+    for (auto& q : builder._result) {
+        auto output = verifier.run_once(builder, q);
+        auto result = output["result"].get<utils::outcome_t>();
+        BOOST_CHECK_EQUAL(result, utils::outcome_t::YES);
+        BOOST_CHECK(output.contains("winner"));
+        BOOST_CHECK_EQUAL(output["portfolio"].size(), 3);
+        BOOST_TEST_MESSAGE(output);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LabelDictionaryTest) {
+    std::vector<std::string> routers{"Router0", "Router1"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(1)->find_interface("iRouter1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    const auto& dictionary = builder.label_dictionary();
+    BOOST_CHECK_EQUAL(&dictionary, &builder.label_dictionary());
+    BOOST_CHECK_EQUAL(dictionary.size(), dictionary.label_set().size());
+    BOOST_CHECK_EQUAL(dictionary.id(Query::unused_label()).value(), LabelDictionary::unused_id());
+    BOOST_CHECK_EQUAL(dictionary.id(Query::bottom_of_stack()).value(), LabelDictionary::bottom_of_stack_id());
+    BOOST_CHECK(std::is_sorted(dictionary.labels().begin() + 2, dictionary.labels().end()));
+    for (size_t id = 0; id < dictionary.size(); ++id) {
+        BOOST_CHECK_EQUAL(dictionary.id(dictionary.label(id)).value(), id);
+    }
+    BOOST_CHECK(dictionary.contains(42));
+    BOOST_CHECK(!dictionary.contains(4242));
+}
+
+BOOST_AUTO_TEST_CASE(RuleTemplatesTest) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    const auto& templates = builder.rule_templates();
+    BOOST_CHECK_EQUAL(&templates, &builder.rule_templates());
+    BOOST_CHECK(templates.op_suffix(0).empty());
+    size_t rules = 0;
+    for (const auto& r : network.routers()) {
+        for (const auto& table : r->tables()) {
+            auto range = templates.table(table.get());
+            auto rule = range.begin();
+            for (const auto& entry : table->entries()) {
+                for (const auto& forward : entry._rules) {
+                    BOOST_REQUIRE(rule != range.end());
+                    BOOST_CHECK_EQUAL(rule->_forward, &forward);
+                    BOOST_CHECK_EQUAL(rule->_pre, entry._top_label);
+                    BOOST_CHECK_EQUAL(rule->_priority, forward._priority);
+                    BOOST_CHECK_EQUAL(rule->_via_id, forward._via->global_id());
+                    BOOST_CHECK_EQUAL(templates.op_suffix(rule->_op_suffix).size() + 1, std::max<size_t>(forward._ops.size(), 1));
+                    ++rule;
+                    ++rules;
+                }
+            }
+            BOOST_CHECK(rule == range.end());
+        }
+    }
+    BOOST_CHECK_EQUAL(templates.size(), rules);
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestResultCache) {
+    std::vector<std::string> routers{"Router0", "Router1"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(1)->find_interface("iRouter1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::string query("<42 43> [.#Router0] [Router0#Router1] [Router1#.] <44 43> 0 OVER");
+
+    std::istringstream qstream(query);
+    builder.do_parse(qstream);
+
+    auto cache_dir = std::filesystem::temp_directory_path() / "aalwines_result_cache_test";
+    std::filesystem::remove_all(cache_dir);
+
+    Verifier verifier;
+    verifier.set_engine(1);
+    verifier.set_trace_type(pdaaal::Trace_Type::Any);
+    verifier.set_result_cache(cache_dir.string());
+    auto first = verifier.run_query(builder, builder._result[0], query, "");
+    BOOST_CHECK(!first.contains("cached"));
+    auto second = verifier.run_query(builder, builder._result[0], "  " + query + " ", "");
+    BOOST_CHECK(second.contains("cached"));
+    BOOST_CHECK(!second.contains("compilation-time")); // The timing of the first run is not reported for the cache hit.
+    BOOST_CHECK(second.contains("full-time"));
+    BOOST_CHECK_EQUAL(second["result"], first["result"]);
+    BOOST_CHECK_EQUAL(second["trace"], first["trace"]);
+    auto other_weight = verifier.run_query(builder, builder._result[0], query, "other weight");
+    BOOST_CHECK(!other_weight.contains("cached"));
+
+    std::filesystem::remove_all(cache_dir);
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestSweepFailures) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::string query("<.> [.#R0] [^.#R1]* [R2#.] <.> 1 OVER");
+
+    std::istringstream qstream(query);
+    builder.do_parse(qstream);
+
+    Verifier verifier;
+    verifier.set_engine(1);
+    verifier.set_trace_type(pdaaal::Trace_Type::Any);
+    verifier.set_sweep_failures(true);
+    auto output = verifier.run_once(builder, builder._result[0]);
+    BOOST_CHECK_EQUAL(output["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+    BOOST_REQUIRE_EQUAL(output["sweep"].size(), 2);
+    BOOST_CHECK_EQUAL(output["sweep"][0]["result"].get<utils::outcome_t>(), utils::outcome_t::NO);
+    BOOST_CHECK_EQUAL(output["sweep"][1]["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+    BOOST_CHECK_EQUAL(output["result-changes-at"], 1);
+    BOOST_CHECK_EQUAL(output["sweep-incomplete"], false);
+    BOOST_CHECK_EQUAL(builder._result[0].number_of_failures(), 1);
+
+    // A sweep that runs out of time stops early, and does not report the bound where it stopped as a change.
+    verifier.set_query_timeout(1e-9);
+    auto timeout = verifier.run_once(builder, builder._result[0]);
+    BOOST_CHECK_EQUAL(timeout["result"].get<utils::outcome_t>(), utils::outcome_t::TIMEOUT);
+    BOOST_CHECK_EQUAL(timeout["sweep"].size(), 1);
+    BOOST_CHECK(timeout["result-changes-at"].is_null());
+    BOOST_CHECK_EQUAL(timeout["sweep-incomplete"], true);
+    BOOST_CHECK_EQUAL(builder._result[0].number_of_failures(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestLazyPDA) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::vector<std::string> queries{"<.> [.#R0] [^.#R1]* [R2#.] <.> 1 OVER", "<.> [.#R0] [^.#R1]* [R2#.] <.> 0 OVER", "<42> [.#R0] .* [R2#.] <.> 0 OVER"};
+    for (const auto& query : queries) {
+        std::istringstream qstream(query);
+        builder.do_parse(qstream);
+    }
+
+    Verifier verifier;
+    verifier.set_engine(1);
+    verifier.set_trace_type(pdaaal::Trace_Type::Any);
+    for (auto& q : builder._result) {
+        verifier.set_lazy_pda(false);
+        auto eager = verifier.run_once(builder, q);
+        verifier.set_lazy_pda(true);
+        auto lazy = verifier.run_once(builder, q);
+        BOOST_CHECK_EQUAL(lazy["result"], eager["result"]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestPrunedPDA) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::vector<std::string> queries{"<.> [.#R0] [^.#R1]* [R2#.] <.> 1 OVER", "<.> [.#R0] [^.#R1]* [R2#.] <.> 0 OVER", "<.> [.#R0] .* [R4#R3] <.> 1 OVER"};
+    for (const auto& query : queries) {
+        std::istringstream qstream(query);
+        builder.do_parse(qstream);
+    }
+
+    Verifier verifier;
+    verifier.set_engine(1);
+    verifier.set_trace_type(pdaaal::Trace_Type::Any);
+    for (auto& q : builder._result) {
+        verifier.set_prune_pda(false);
+        auto full = verifier.run_once(builder, q);
+        verifier.set_prune_pda(true);
+        auto pruned = verifier.run_once(builder, q);
+        BOOST_CHECK_EQUAL(pruned["result"], full["result"]);
+    }
+
+    // No table forwards from R4 to R3, so no pair can reach the end of the path.
+    auto& q = builder._result[2];
+    q.compile_nfas();
+    PathReachability::pairs_t initial;
+    NetworkTranslation(q, network).make_initial_states([&initial](const Interface* inf, const PathReachability::nfa_state_t* nfa_state){
+        initial.emplace_back(inf, nfa_state);
+    });
+    PathReachability reachability(network, q.path_index(), builder.rule_templates(), q.number_of_failures(), initial);
+    BOOST_CHECK_EQUAL(reachability.number_of_relevant(), 0);
+    BOOST_CHECK_EQUAL(verifier.run_once(builder, q)["result"], false);
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestSlicedLabels) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::vector<std::string> queries{"<42> [.#R0] .* [R2#.] <.> 1 OVER", "<42> [.#R0] .* [R2#.] <.> 0 OVER", "<.> [.#R0] [^.#R1]* [R2#.] <.> 1 OVER", "<43> [.#R0] .* [R2#.] <.> 0 OVER"};
+    for (const auto& query : queries) {
+        std::istringstream qstream(query);
+        builder.do_parse(qstream);
+    }
+
+    Verifier verifier;
+    verifier.set_engine(1);
+    verifier.set_trace_type(pdaaal::Trace_Type::Any);
+    for (auto& q : builder._result) {
+        verifier.set_slice_labels(false);
+        auto full = verifier.run_once(builder, q);
+        verifier.set_slice_labels(true);
+        auto sliced = verifier.run_once(builder, q);
+        BOOST_CHECK_EQUAL(sliced["result"], full["result"]);
+    }
+
+    // Starting with 42 at R0, the data flow swaps it to 43 on the way to R1.
+    auto& q = builder._result[1];
+    q.compile_nfas();
+    std::vector<const Interface*> initial;
+    NetworkTranslation(q, network).make_initial_states([&initial](const Interface* inf, const LabelFlow::NFA::state_t*){
+        initial.push_back(inf);
+    });
+    LabelFlow flow(builder.rule_templates(), q.construction(), initial, q.number_of_failures());
+    auto r1_table = network.get_router(1)->find_interface("R0")->table();
+    BOOST_CHECK(flow.may_reach(r1_table, 43));
+    BOOST_CHECK(!flow.may_reach(r1_table, 42));
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestOpChains) {
+    std::vector<std::string> routers{"R0", "R1"};
+    std::vector<std::vector<std::string>> links{{"R1"},{"R0"}};
+
+    auto network = Network::make_network(routers, links);
+    auto r0_in = network.get_router(0)->find_interface("iR0");
+    auto r0_out = network.get_router(0)->find_interface("R1");
+    auto r1_in = network.get_router(1)->find_interface("R0");
+    auto r1_out = network.get_router(1)->find_interface("iR1");
+    using action_t = RoutingTable::action_t;
+    using op_t = RoutingTable::op_t;
+    r0_in->table()->add_rule(10, RoutingTable::forward_t({action_t(op_t::SWAP, 11), action_t(op_t::PUSH, 20), action_t(op_t::PUSH, 30)}, r0_out, 0));
+    r1_in->table()->add_rule(30, RoutingTable::forward_t({action_t(op_t::POP), action_t(op_t::POP)}, r1_out, 0));
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::vector<std::string> queries{"<10> [.#R0] [R0#R1] [R1#.] <11> 0 OVER", "<10> [.#R0] [R0#R1] [R1#.] <10> 0 OVER"};
+    for (const auto& query : queries) {
+        std::istringstream qstream(query);
+        builder.do_parse(qstream);
+    }
+
+    Verifier verifier;
+    verifier.set_engine(1);
+    verifier.set_trace_type(pdaaal::Trace_Type::Any);
+    auto yes = verifier.run_once(builder, builder._result[0]);
+    BOOST_CHECK_EQUAL(yes["result"], true);
+    BOOST_CHECK(yes["trace"].is_array());
+    auto no = verifier.run_once(builder, builder._result[1]);
+    BOOST_CHECK_EQUAL(no["result"], false);
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestCegarEngines) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::vector<std::string> queries{"<.> [.#R0] [^.#R1]* [R2#.] <.> 1 OVER", "<.> [.#R0] [^.#R1]* [R2#.] <.> 0 OVER",
+                                     "<42> [.#R0] .* [R2#.] <.> 1 OVER", "<43> [.#R0] .* [R2#.] <.> 0 OVER", "<.> [.#R0] .* [R4#R3] <.> 1 OVER"};
+    for (const auto& query : queries) {
+        std::istringstream qstream(query);
+        builder.do_parse(qstream);
+    }
+
+    // The CEGAR engines refine (and update the abstract tables) until the answer is conclusive, so they must agree with post*.
+    Verifier verifier;
+    verifier.set_trace_type(pdaaal::Trace_Type::Any);
+    for (auto& q : builder._result) {
+        verifier.set_engine(1);
+        auto expected = verifier.run_once(builder, q);
+        for (size_t engine : {4, 5, 7}) {
+            verifier.set_engine(engine);
+            auto cegar = verifier.run_once(builder, q);
+            BOOST_CHECK_EQUAL(cegar["result"], expected["result"]);
+        }
+    }
+
+    // The label 42 of the initial header gets its own abstract label from the start.
+    verifier.set_engine(4);
+    auto seeded = verifier.run_once(builder, builder._result[2]);
+    BOOST_CHECK_EQUAL(seeded["abstraction"]["seeded_labels"], 1);
+
+    // One statistics entry per iteration. Each but the last ended with a refinement.
+    const auto& iterations = seeded["abstraction"]["iterations"];
+    BOOST_REQUIRE_EQUAL(iterations.size(), seeded["abstraction"]["cegar_iterations"].get<size_t>());
+    for (size_t j = 0; j < iterations.size(); ++j) {
+        for (const auto& phase : {"build_pda", "solver", "reconstruction", "find_refinement", "refine"}) {
+            BOOST_CHECK_GE(iterations[j][phase].get<double>(), 0);
+        }
+        BOOST_CHECK(iterations[j].contains("rules") && iterations[j].contains("states") && iterations[j].contains("resident_memory"));
+        BOOST_CHECK_EQUAL(iterations[j]["refinement"].is_null(), j + 1 == iterations.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestCegarSeededLabels) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    // Both flows enter with labels (42 and 46) that are forwarded from R0 to R1, so the two labels are in the same next-hop group.
+    // At R1 the flow of 46 leaves the network, while the flow of 42 continues to R2.
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(1)->find_interface("iR1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::istringstream qstream("<42> [.#R0] .* [R1#.] <.> 0 OVER");
+    builder.do_parse(qstream);
+
+    // Without seeding, the abstract label of 42 also stands for 46, which gives a spurious trace leaving at R1 that must be refined away.
+    json seeded, unseeded;
+    auto seeded_res = CegarVerifier::verify(builder.compiled_network(), builder._result[0], builder.label_dictionary(), seeded);
+    auto unseeded_res = CegarVerifier::verify(builder.compiled_network(), builder._result[0], builder.label_dictionary(), unseeded,
+                                              nullptr, 1, nullptr, nullptr, false);
+    BOOST_CHECK(!seeded_res);
+    BOOST_CHECK(!unseeded_res);
+    BOOST_CHECK_EQUAL(seeded["seeded_labels"], 1);
+    BOOST_CHECK_EQUAL(unseeded["seeded_labels"], 0);
+    BOOST_CHECK_LT(seeded["cegar_iterations"].get<size_t>(), unseeded["cegar_iterations"].get<size_t>());
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestCegarSeededLabelsAgis) {
+    std::stringstream warnings;
+    auto network = FastJsonBuilder::parse(std::string(AALWINES_EXAMPLE_NET_DIR) + "/Agis-network.json", warnings);
+    network.pre_process();
+
+    // The first query of Agis-query.q, with the label 1464 (forwarded from Stockton to Santa_Clara) instead of <.> as the initial header.
+    Builder builder(network);
+    std::istringstream qstream("<1464> [.#Stockton] .* [Santa_Clara#.] <.> 0 OVER");
+    builder.do_parse(qstream);
+
+    json seeded, unseeded;
+    auto seeded_res = CegarVerifier::verify(builder.compiled_network(), builder._result[0], builder.label_dictionary(), seeded);
+    auto unseeded_res = CegarVerifier::verify(builder.compiled_network(), builder._result[0], builder.label_dictionary(), unseeded,
+                                              nullptr, 1, nullptr, nullptr, false);
+    BOOST_CHECK_EQUAL(seeded_res.has_value(), unseeded_res.has_value());
+    BOOST_CHECK_EQUAL(seeded["seeded_labels"], 1);
+    BOOST_TEST_MESSAGE("Agis cegar_iterations: seeded " << seeded["cegar_iterations"] << ", unseeded " << unseeded["cegar_iterations"]);
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestCegarAbstractionCache) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::vector<std::string> queries{"<.> [.#R0] [^.#R1]* [R2#.] <.> 1 OVER", "<42> [.#R0] .* [R2#.] <.> 1 OVER", "<.> [.#R0] .* [R4#R3] <.> 1 OVER"};
+    for (const auto& query : queries) {
+        std::istringstream qstream(query);
+        builder.do_parse(qstream);
+    }
+
+    auto cache_dir = std::filesystem::temp_directory_path() / "aalwines_abstraction_cache_test";
+    std::filesystem::remove_all(cache_dir);
+
+    // The abstraction is saved per query, so only the first run of each query starts from the default abstraction.
+    // Later runs of the query start from the abstraction saved by the previous run, and give the same answers.
+    Verifier verifier;
+    verifier.set_trace_type(pdaaal::Trace_Type::Any);
+    verifier.set_cegar_abstraction_cache(cache_dir.string());
+    for (size_t engine : {4, 5, 7}) {
+        verifier.set_engine(engine);
+        for (auto& q : builder._result) {
+            Verifier expected; // Without the cache.
+            expected.set_trace_type(pdaaal::Trace_Type::Any);
+            expected.set_engine(engine);
+            auto cold = expected.run_once(builder, q);
+            auto warm = verifier.run_once(builder, q);
+            BOOST_CHECK_EQUAL(warm["result"], cold["result"]);
+            BOOST_CHECK_EQUAL(warm["abstraction"]["warm_start"], engine != 4);
+            BOOST_CHECK_EQUAL(cold["abstraction"]["warm_start"], false);
+        }
+    }
+
+    std::filesystem::remove_all(cache_dir);
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestCegarShortestTrace) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::vector<std::string> queries{"<.> [.#R0] .* [R2#.] <.> 1 OVER", "<.> [.#R0] .* [R4#R3] <.> 1 OVER"};
+    for (const auto& query : queries) {
+        std::istringstream qstream(query);
+        builder.do_parse(qstream);
+    }
+    std::stringstream wstream(R"([[{"atom": "hops"}]])");
+    auto weight_fn = NetworkWeight().parse(wstream);
+
+    Verifier verifier;
+    verifier.set_trace_type(pdaaal::Trace_Type::Shortest);
+    for (auto& q : builder._result) {
+        verifier.set_engine(1);
+        auto expected = verifier.run_once(builder, q, false, weight_fn);
+        // CEGAR decides the query, and the weighted witness comes from post*, so the CEGAR engines report the same shortest trace weight.
+        for (size_t engine : {4, 5, 7}) {
+            verifier.set_engine(engine);
+            auto cegar = verifier.run_once(builder, q, false, weight_fn);
+            BOOST_CHECK_EQUAL(cegar["result"], expected["result"]);
+            BOOST_CHECK_EQUAL(cegar.contains("trace-weight"), expected.contains("trace-weight"));
+            if (expected.contains("trace-weight")) {
+                BOOST_CHECK_EQUAL(cegar["trace-weight"], expected["trace-weight"]);
+                BOOST_CHECK_EQUAL(cegar["trace-engine"], "Post*");
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestCegarLabelPartition) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::string query("<.> [.#R0] .* [R2#.] <.> 1 OVER");
+    std::istringstream qstream(query);
+    builder.do_parse(qstream);
+    const auto& labels = builder.label_dictionary();
+
+    auto serial = CegarVerifier::next_hop_label_partition(network, builder._result[0], labels);
+    auto parallel = CegarVerifier::next_hop_label_partition(network, builder._result[0], labels, 4);
+    BOOST_CHECK_EQUAL_COLLECTIONS(parallel.begin(), parallel.end(), serial.begin(), serial.end());
+    // Ids are dense and assigned in order of label id.
+    size_t next_id = 0;
+    for (auto id : serial) {
+        if (id == std::numeric_limits<size_t>::max()) continue;
+        BOOST_CHECK_LE(id, next_id);
+        if (id == next_id) ++next_id;
+    }
+    BOOST_CHECK_GT(next_id, 0);
+    BOOST_CHECK_EQUAL(serial[LabelDictionary::bottom_of_stack_id()], std::numeric_limits<size_t>::max());
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestParallelBuild) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::string query("<.> [.#R0] [^.#R1]* [R2#.] <.> 1 OVER");
+    std::istringstream qstream(query);
+    builder.do_parse(qstream);
+    auto& q = builder._result[0];
+    q.compile_nfas();
+
+    NetworkPDAFactory serial_factory(q, network, builder.all_labels());
+    auto serial = serial_factory.compile(q.construction(), q.destruction());
+    BOOST_REQUIRE(pdaaal::Solver::post_star_accepts<pdaaal::Trace_Type::Any>(*serial));
+    auto serial_trace = serial_factory.get_json_trace(pdaaal::Solver::get_trace(*serial));
+
+    NetworkPDAFactory parallel_factory(q, network, builder.all_labels());
+    parallel_factory.set_threads(4, 1);
+    auto parallel = parallel_factory.compile(q.construction(), q.destruction());
+    BOOST_REQUIRE(pdaaal::Solver::post_star_accepts<pdaaal::Trace_Type::Any>(*parallel));
+    auto parallel_trace = parallel_factory.get_json_trace(pdaaal::Solver::get_trace(*parallel));
+    BOOST_CHECK_EQUAL(parallel_trace, serial_trace);
+
+    Verifier verifier;
+    verifier.set_engine(1);
+    verifier.set_trace_type(pdaaal::Trace_Type::Any);
+    auto serial_output = verifier.run_once(builder, q);
+    verifier.set_build_threads(4);
+    auto parallel_output = verifier.run_once(builder, q);
+    BOOST_CHECK_EQUAL(parallel_output["result"], serial_output["result"]);
+    BOOST_CHECK_EQUAL(parallel_output["trace"], serial_output["trace"]);
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestSharedConstruction) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iR0"), network.get_router(2)->find_interface("iR2"), next_label);
+    RouteConstruction::make_reroute(network.get_router(0)->find_interface("R1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    // Header variants of the same path and k are verified with one shared construction.
+    Builder builder(network);
+    std::vector<std::string> query_strings{"<.> [.#R0] [^.#R1]* [R2#.] <.> 1 OVER", "<42> [.#R0] [^.#R1]* [R2#.] <.> 1 OVER",
+                                           "<.> [.#R0] [^.#R1]* [R2#.] <43> 1 OVER", "<44 .> [.#R0] [^.#R1]* [R2#.] <.*> 1 OVER",
+                                           "<.> [.#R0] [^.#R1]* [R2#.] <.> 1 UNDER"};
+    std::stringstream queries;
+    for (const auto& query : query_strings) queries << query << std::endl;
+    builder.do_parse(queries);
+    for (auto& q : builder._result) q.compile_nfas();
+
+    for (size_t threads : {1, 2}) {
+        Verifier verifier;
+        verifier.set_engine(1);
+        verifier.set_threads(threads);
+        verifier.set_trace_type(pdaaal::Trace_Type::Any);
+        std::stringstream out;
+        {
+            json_stream json_output(4, out);
+            verifier.run(builder, query_strings, json_output, false);
+        }
+        auto answers = json::parse(out.str())["answers"];
+        BOOST_REQUIRE_EQUAL(answers.size(), query_strings.size());
+        for (size_t query_no = 0; query_no < query_strings.size(); ++query_no) {
+            auto separate = verifier.run_once(builder, builder._result[query_no], false); // Not grouped, so built from scratch.
+            const auto& grouped = answers["Q" + std::to_string(query_no + 1)];
+            BOOST_CHECK_EQUAL(grouped["result"], separate["result"]);
+            BOOST_CHECK_EQUAL(grouped["trace"], separate["trace"]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(QueryTestParallelError) {
+    std::vector<std::string> routers{"R0", "R1", "R2"};
+    std::vector<std::vector<std::string>> links{{"R1"},{"R0", "R2"}, {"R1"}};
+
+    auto network = Network::make_network(routers, links);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::vector<std::string> query_strings{"<.> [.#R0] .* [R2#.] <.> 0 OVER", "<.> [.#R1] .* [R2#.] <.> 0 OVER", "<.> [.#R2] .* [R0#.] <.> 0 OVER"};
+    std::stringstream queries;
+    for (const auto& query : query_strings) queries << query << std::endl;
+    builder.do_parse(queries);
+    for (auto& q : builder._result) q.compile_nfas();
+
+    // Longest traces need a weight, so every query throws. The error must reach the caller instead of blocking the workers.
+    Verifier verifier;
+    verifier.set_engine(1);
+    verifier.set_threads(2);
+    verifier.set_trace_type(pdaaal::Trace_Type::Longest);
+    std::stringstream out;
+    json_stream json_output(4, out);
+    BOOST_CHECK_THROW(verifier.run(builder, query_strings, json_output, false), base_error);
+}
+
+BOOST_AUTO_TEST_CASE(PathEdgeIndexTest) {
+    std::vector<std::string> routers{"R0", "R1", "R2", "R3", "R4"};
+    std::vector<std::vector<std::string>> links{{"R1", "R3"},{"R0", "R2"}, {"R1", "R4"}, {"R0", "R4"}, {"R2", "R3"}};
+
+    auto network = Network::make_network(routers, links);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    std::string query("<.> [.#R0] [^.#R1]* [R2#.] <.> 1 OVER");
+    std::istringstream qstream(query);
+    builder.do_parse(qstream);
+    auto& q = builder._result[0];
+    q.compile_nfas();
+
+    auto check_index = [&network](const Query& query) {
+        const auto& index = query.path_index();
+        for (const auto& state : query.path().states()) {
+            auto row = index.row(state.get());
+            for (const auto& inf : network.all_interfaces()) {
+                std::vector<PathEdgeIndex::nfa_state_t*> expected;
+                for (const auto& e : state->_edges) {
+                    if (!e.contains(inf->global_id())) continue;
+                    auto next = e.follow_epsilon();
+                    expected.insert(expected.end(), next.begin(), next.end());
+                }
+                BOOST_CHECK(index.successors(row, inf->global_id()) == expected);
+            }
+        }
+    };
+    check_index(q);
+    Query copy(q); // The copy must get an index of its own NFA.
+    check_index(copy);
+}
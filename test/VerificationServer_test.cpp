@@ -0,0 +1,118 @@
+/* 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   VerificationServer_test
+ *
+ * Created on 17-10-2026.
+ */
+
+#define BOOST_TEST_MODULE VerificationServerTest
+
+#include <boost/test/unit_test.hpp>
+#include <aalwines/model/Network.h>
+#include <aalwines/VerificationServer.h>
+#include <aalwines/synthesis/RouteConstruction.h>
+#include <set>
+#include <thread>
+
+using namespace aalwines;
+
+BOOST_AUTO_TEST_CASE(VerificationServerTest1) {
+    std::vector<std::string> routers{"Router0", "Router1"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(1)->find_interface("iRouter1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    Verifier verifier;
+    verifier.set_engine(1);
+    verifier.set_threads(2);
+    VerificationServer server(builder, verifier, std::nullopt, false);
+
+    std::stringstream in, out;
+    in << R"({"id": 1, "query": "<42 43> [.#Router0] [Router0#Router1] [Router1#.] <44 43> 0 OVER"})" << std::endl;
+    in << R"({"id": 2, "query": "<42 43> [.#Router1] .* [.#Router0] <44 43> 0 OVER"})" << std::endl;
+    in << R"({"id": 3, "query": "<42 43> [.#Router0"})" << std::endl;
+    in << R"(not json)" << std::endl;
+    server.serve(in, out);
+
+    std::map<int, json> responses;
+    std::string line;
+    int without_id = 0;
+    while (std::getline(out, line)) {
+        auto response = json::parse(line);
+        if (response.contains("id")) {
+            responses[response["id"].get<int>()] = response;
+        } else {
+            without_id++;
+            BOOST_CHECK(response.contains("error"));
+        }
+    }
+    BOOST_CHECK_EQUAL(without_id, 1);
+    BOOST_REQUIRE_EQUAL(responses.size(), 3);
+    BOOST_CHECK_EQUAL(responses[1]["answer"]["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+    BOOST_CHECK(responses[2]["answer"].contains("result"));
+    BOOST_CHECK_EQUAL(responses[2]["answer"]["query"], "<42 43> [.#Router1] .* [.#Router0] <44 43> 0 OVER");
+    BOOST_CHECK(responses[3].contains("error"));
+    BOOST_CHECK(builder._result.empty());
+}
+
+BOOST_AUTO_TEST_CASE(VerificationServerConcurrentStreams) {
+    std::vector<std::string> routers{"Router0", "Router1"};
+    std::vector<std::vector<std::string>> links{{"Router1"},{"Router0"}};
+
+    auto network = Network::make_network(routers, links);
+    uint64_t i = 42;
+    auto next_label = [&i](){return i++;};
+    RouteConstruction::make_data_flow(network.get_router(0)->find_interface("iRouter0"), network.get_router(1)->find_interface("iRouter1"), next_label);
+    network.prepare_tables(); network.pre_process();
+
+    Builder builder(network);
+    Verifier verifier;
+    verifier.set_engine(1);
+    verifier.set_threads(2);
+    VerificationServer server(builder, verifier, std::nullopt, false);
+
+    // Streams served at the same time share the pool, but each call returns once its own requests are answered.
+    constexpr size_t streams = 3, requests = 4;
+    std::vector<std::stringstream> ins(streams), outs(streams);
+    for (size_t s = 0; s < streams; ++s) {
+        for (size_t r = 0; r < requests; ++r) {
+            ins[s] << R"({"id": )" << r << R"(, "query": "<42 43> [.#Router0] [Router0#Router1] [Router1#.] <44 43> 0 OVER"})" << std::endl;
+        }
+    }
+    std::vector<std::thread> threads;
+    for (size_t s = 0; s < streams; ++s) {
+        threads.emplace_back([&server, &ins, &outs, s](){ server.serve(ins[s], outs[s]); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto& out : outs) {
+        std::set<size_t> ids;
+        std::string line;
+        while (std::getline(out, line)) {
+            auto response = json::parse(line);
+            BOOST_CHECK_EQUAL(response["answer"]["result"].get<utils::outcome_t>(), utils::outcome_t::YES);
+            ids.insert(response["id"].get<size_t>());
+        }
+        BOOST_CHECK_EQUAL(ids.size(), requests);
+    }
+}
@@ -0,0 +1,69 @@
+/* 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   flat_id_set_test
+ *
+ * Created on 17-10-2026.
+ */
+
+#define BOOST_TEST_MODULE flat_id_set_test
+
+#include <boost/test/unit_test.hpp>
+#include <aalwines/utils/flat_id_set.h>
+#include <tuple>
+
+using namespace aalwines;
+
+struct tuple_hash {
+    size_t operator()(const std::tuple<size_t,size_t,size_t>& t) const {
+        return utils::mix_hash(std::get<0>(t) ^ utils::mix_hash(std::get<1>(t) ^ utils::mix_hash(std::get<2>(t))));
+    }
+};
+
+BOOST_AUTO_TEST_CASE(flat_id_set_dense_ids)
+{
+    utils::flat_id_set<size_t> set;
+    BOOST_CHECK(set.empty());
+    BOOST_CHECK(!set.find(7));
+    for (size_t i = 0; i < 1000; ++i) {
+        auto [inserted, id] = set.insert(i * 8); // Same low bits, like pointers.
+        BOOST_CHECK(inserted);
+        BOOST_CHECK_EQUAL(id, i);
+    }
+    BOOST_CHECK_EQUAL(set.size(), 1000);
+    for (size_t i = 0; i < 1000; ++i) {
+        auto [inserted, id] = set.insert(i * 8);
+        BOOST_CHECK(!inserted);
+        BOOST_CHECK_EQUAL(id, i);
+        BOOST_CHECK_EQUAL(set.at(i), i * 8);
+        BOOST_CHECK_EQUAL(set.find(i * 8).value(), i);
+    }
+    BOOST_CHECK(!set.find(4));
+    BOOST_CHECK_EQUAL(set.size(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(flat_id_set_tuple_keys)
+{
+    utils::flat_id_set<std::tuple<size_t,size_t,size_t>, tuple_hash> set;
+    for (size_t i = 0; i < 20; ++i) {
+        for (size_t j = 0; j < 20; ++j) {
+            BOOST_CHECK(set.insert(std::make_tuple(i, j, i + j)).first);
+        }
+    }
+    BOOST_CHECK_EQUAL(set.size(), 400);
+    BOOST_CHECK_EQUAL(set.find(std::make_tuple(3, 4, 7)).value(), 3 * 20 + 4);
+    BOOST_CHECK(!set.find(std::make_tuple(3, 4, 8)));
+}
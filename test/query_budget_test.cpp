@@ -0,0 +1,78 @@
+/* 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   query_budget_test
+ *
+ * Created on 17-10-2026.
+ */
+
+#define BOOST_TEST_MODULE query_budget_test
+
+#include <boost/test/unit_test.hpp>
+#include <aalwines/utils/query_budget.h>
+#include <thread>
+
+using namespace aalwines;
+
+BOOST_AUTO_TEST_CASE(query_budget_unlimited)
+{
+    utils::query_budget budget;
+    BOOST_CHECK(budget.unlimited());
+    for (size_t i = 0; i < 10000; ++i) {
+        BOOST_REQUIRE_NO_THROW(budget.check());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(query_budget_timeout)
+{
+    utils::query_budget budget(0.01, 0);
+    BOOST_CHECK_NO_THROW(budget.check());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    try {
+        budget.check();
+        BOOST_FAIL("Expected timeout");
+    } catch (const utils::budget_exceeded& e) {
+        BOOST_CHECK_EQUAL(e.outcome(), utils::outcome_t::TIMEOUT);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(query_budget_memout)
+{
+    utils::query_budget budget(0, 1); // 1 byte is always exceeded (where resident memory can be determined).
+    if (resident_memory() == 0) return;
+    try {
+        budget.check();
+        BOOST_FAIL("Expected memout");
+    } catch (const utils::budget_exceeded& e) {
+        BOOST_CHECK_EQUAL(e.outcome(), utils::outcome_t::MEMOUT);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(query_budget_cancel_from_other_thread)
+{
+    utils::query_budget budget;
+    std::thread([&budget](){ budget.cancel(); }).join();
+    BOOST_CHECK(budget.cancelled());
+    BOOST_CHECK_THROW(budget.check(), utils::budget_exceeded);
+}
+
+BOOST_AUTO_TEST_CASE(outcome_json_roundtrip)
+{
+    for (auto outcome : {utils::outcome_t::YES, utils::outcome_t::NO, utils::outcome_t::MAYBE, utils::outcome_t::TIMEOUT, utils::outcome_t::MEMOUT}) {
+        utils::json j = outcome;
+        BOOST_CHECK_EQUAL(j.get<utils::outcome_t>(), outcome);
+    }
+}
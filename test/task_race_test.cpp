@@ -0,0 +1,100 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+/*
+ * File:   task_race_test
+ *
+ * Created on 17-10-2026.
+ */
+
+#define BOOST_TEST_MODULE task_race_test
+
+#include <boost/test/unit_test.hpp>
+#include <aalwines/utils/task_race.h>
+#include <aalwines/utils/stopwatch.h>
+#include <thread>
+
+using namespace aalwines;
+using json = nlohmann::json;
+
+namespace {
+    bool is_done(const json& output) { return output["done"].get<bool>(); }
+}
+
+BOOST_AUTO_TEST_CASE(task_race_returns_with_fast_task)
+{
+    // The slow tasks take 100 times longer than the fast one. One checks its budget, the other one never does (like a task inside the solver).
+    std::atomic<bool> stuck_finished = false;
+    utils::task_race race;
+    std::vector<utils::task_race::task_t> tasks;
+    tasks.emplace_back([](const utils::query_budget& budget){
+        for (size_t i = 0; i < 2000; ++i) {
+            budget.check();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return json{{"done", true}};
+    });
+    tasks.emplace_back([&stuck_finished](const utils::query_budget&){
+        std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+        stuck_finished = true;
+        return json{{"done", true}};
+    });
+    tasks.emplace_back([](const utils::query_budget&){
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return json{{"done", true}};
+    });
+    stopwatch time;
+    auto [winner, results] = race.run(std::move(tasks), is_done, 0, 0);
+    time.stop();
+
+    BOOST_REQUIRE(winner);
+    BOOST_CHECK_EQUAL(winner.value(), 2);
+    BOOST_CHECK_LT(time.duration(), 1.0);
+    BOOST_CHECK(!stuck_finished);
+    BOOST_REQUIRE_EQUAL(results.size(), 3);
+    BOOST_CHECK(results[2].output && !results[2].cancelled);
+    for (size_t i = 0; i < 2; ++i) {
+        BOOST_CHECK(results[i].cancelled);
+        BOOST_CHECK(!results[i].output); // Still running when the race was decided.
+    }
+
+    race.wait();
+    BOOST_CHECK(stuck_finished);
+}
+
+BOOST_AUTO_TEST_CASE(task_race_without_winner)
+{
+    // Without a conclusive output, the race waits for all tasks and reports their outputs and errors.
+    utils::task_race race;
+    std::vector<utils::task_race::task_t> tasks;
+    tasks.emplace_back([](const utils::query_budget&){ return json{{"done", false}}; });
+    tasks.emplace_back([](const utils::query_budget&) -> json { throw std::runtime_error("failed"); });
+    tasks.emplace_back([](const utils::query_budget& budget){
+        while (true) budget.check(); // Runs out of time.
+        return json{{"done", true}};
+    });
+    auto [winner, results] = race.run(std::move(tasks), is_done, 0.02, 0);
+
+    BOOST_CHECK(!winner);
+    BOOST_REQUIRE_EQUAL(results.size(), 3);
+    BOOST_CHECK(results[0].output && !results[0].error);
+    BOOST_CHECK(!results[1].output && results[1].error);
+    BOOST_CHECK(!results[2].output && results[2].error);
+    for (const auto& result : results) {
+        BOOST_CHECK(!result.cancelled);
+    }
+}
@@ -0,0 +1,66 @@
+/* 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * File:   work_stealing_pool_test
+ *
+ * Created on 17-10-2026.
+ */
+
+#define BOOST_TEST_MODULE work_stealing_pool_test
+
+#include <boost/test/unit_test.hpp>
+#include <aalwines/utils/work_stealing_pool.h>
+
+using namespace aalwines;
+
+BOOST_AUTO_TEST_CASE(work_stealing_pool_runs_all_tasks)
+{
+    std::vector<size_t> results(1000, 0);
+    utils::work_stealing_pool pool(4);
+    for (size_t i = 0; i < results.size(); ++i) {
+        pool.submit([&results, i](){ results[i] = i * i; });
+    }
+    pool.wait();
+    for (size_t i = 0; i < results.size(); ++i) {
+        BOOST_CHECK_EQUAL(results[i], i * i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(work_stealing_pool_nested_submit)
+{
+    // Tasks submitted from within a running task are also awaited by wait().
+    std::atomic<size_t> finished = 0;
+    utils::work_stealing_pool pool(3);
+    for (size_t i = 0; i < 8; ++i) {
+        pool.submit([&pool, &finished](){
+            for (size_t j = 0; j < 4; ++j) {
+                pool.submit([&finished](){
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    ++finished;
+                });
+            }
+            ++finished;
+        });
+    }
+    pool.wait();
+    BOOST_CHECK_EQUAL(finished, 40);
+}
+
+BOOST_AUTO_TEST_CASE(work_stealing_pool_resolve_threads)
+{
+    BOOST_CHECK_EQUAL(utils::work_stealing_pool::resolve_threads(3), 3);
+    BOOST_CHECK_GE(utils::work_stealing_pool::resolve_threads(0), 1);
+}